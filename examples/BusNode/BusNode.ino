@@ -0,0 +1,39 @@
+/*
+TelemetryJet Arduino SDK
+Chris Dalke <chrisdalke@gmail.com>
+https://github.com/telemetryjet/telemetryjet-arduino-sdk
+
+Lightweight communication library for hardware telemetry data. 
+Handles bidirectional communication and state management for data points. 
+-------------------------------------------------------------------------
+Part of the TelemetryJet platform -- Collect, analyze, and share
+data from your hardware. Code not required.
+
+Distributed "as is" under the MIT License. See LICENSE.md for details.
+*/
+
+#include <TelemetryJet.h>
+
+// Address of this board on the bus, from 1 to the number of nodes configured on the master
+#define NODE_ADDRESS 3
+
+// Driver enable pin of the RS-485 transceiver (DE and /RE tied together)
+#define DIRECTION_PIN 2
+
+// The bus is on Serial1. Every node on the bus uses its own range of keys.
+TelemetryJet telemetry(&Serial1, 100);
+TypedDimension<float> temperature = telemetry.createDimension<float>(NODE_ADDRESS * 10);
+
+void setup() {
+  // Transmit only during this node's slot, as announced by the master.
+  // The master calls setBusMaster(BusSchedule::SLOTTED, numNodes, slotLength) instead.
+  telemetry.setBusNode(NODE_ADDRESS, BusSchedule::SLOTTED);
+  telemetry.setBusDirectionPin(DIRECTION_PIN);
+
+  Serial1.begin(115200);
+}
+
+void loop() {
+  temperature.set(analogRead(A0) * 0.1f);
+  telemetry.update();
+}
@@ -0,0 +1,61 @@
+/*
+TelemetryJet Arduino SDK
+Chris Dalke <chrisdalke@gmail.com>
+https://github.com/telemetryjet/telemetryjet-arduino-sdk
+
+Lightweight communication library for hardware telemetry data. 
+Handles bidirectional communication and state management for data points. 
+-------------------------------------------------------------------------
+Part of the TelemetryJet platform -- Collect, analyze, and share
+data from your hardware. Code not required.
+
+Distributed "as is" under the MIT License. See LICENSE.md for details.
+*/
+
+#include <CAN.h>
+#include <TelemetryJet.h>
+
+// CAN driver for TelemetryJet, over the arduino-CAN library (MCP2515 or ESP32 SJA1000)
+class ArduinoCanDriver : public CanDriver {
+ public:
+  bool write(uint32_t id, const uint8_t* data, uint8_t length) {
+    if (id > 0x7FF) {
+      CAN.beginExtendedPacket(id);
+    } else {
+      CAN.beginPacket(id);
+    }
+    CAN.write(data, length);
+    return CAN.endPacket() == 1;
+  }
+
+  bool read(uint32_t* id, uint8_t* data, uint8_t* length) {
+    int size = CAN.parsePacket();
+    if (size <= 0 || CAN.packetRtr()) {
+      return false;
+    }
+    *id = CAN.packetId();
+    *length = 0;
+    while (CAN.available() && *length < 8) {
+      data[(*length)++] = CAN.read();
+    }
+    return true;
+  }
+};
+
+ArduinoCanDriver canDriver;
+
+// The CAN bus is the only transport: key 1 is sent with CAN ID 0x101, key 2 with 0x102.
+// Larger records go out in segmented batches on 0x7F0; the host sends its batches on 0x7F1.
+TelemetryJet telemetry(&canDriver, 0x100, 0x7F0, 0x7F1, 100);
+TypedDimension<float> temperature = telemetry.createDimension<float>(1);
+TypedDimension<uint16_t> rpm = telemetry.createDimension<uint16_t>(2);
+
+void setup() {
+  CAN.begin(500E3);
+}
+
+void loop() {
+  temperature.set(analogRead(A0) * 0.1f);
+  rpm.set(millis() % 6000);
+  telemetry.update();
+}
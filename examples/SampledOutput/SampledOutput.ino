@@ -0,0 +1,47 @@
+/*
+TelemetryJet Arduino SDK
+Chris Dalke <chrisdalke@gmail.com>
+https://github.com/telemetryjet/telemetryjet-arduino-sdk
+
+Lightweight communication library for hardware telemetry data. 
+Handles bidirectional communication and state management for data points. 
+-------------------------------------------------------------------------
+Part of the TelemetryJet platform -- Collect, analyze, and share
+data from your hardware. Code not required.
+
+Distributed "as is" under the MIT License. See LICENSE.md for details.
+*/
+
+#include <TelemetryJet.h>
+
+// Initialize an instance of the TelemetryJet SDK.
+// Here, the SDK is configured to send new data every 100ms.
+TelemetryJet telemetry(&Serial, 100);
+
+// Create two dimensions, with their value types fixed as float and unsigned 32-bit integer.
+TypedDimension<float> signalValue = telemetry.createDimension<float>(1);
+TypedDimension<uint32_t> loopCount = telemetry.createDimension<uint32_t>(2);
+
+// A regular variable, updated by the sketch
+uint32_t loops = 0;
+
+// A sampler function, called by TelemetryJet only when the value is about to be sent
+float sampleSignal() {
+  return sin(millis() / 1000.0) * 100.0;
+}
+
+void setup() {
+  // Bind the dimensions to their sources.
+  // Instead of calling a setter on every loop, TelemetryJet reads
+  // the variable and calls the sampler once per transmit interval.
+  signalValue.bind(sampleSignal);
+  loopCount.bind(&loops);
+
+  Serial.begin(115200);
+  while (!Serial);
+}
+
+void loop() {
+  telemetry.update();
+  loops++;
+}
@@ -39,6 +39,9 @@
 #include "mpack-config.h"
 #endif
 
+/* TelemetryJet: feature profile for the embedded build */
+#include "TelemetryJetConfig.h"
+
 
 /* mpack/mpack-defaults.h.h */
 
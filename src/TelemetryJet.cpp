@@ -16,10 +16,465 @@ Distributed "as is" under the MIT License. See LICENSE.md for details.
 
 const char* timestampField = "ts";
 
-TelemetryJet::TelemetryJet(Stream *transport, unsigned long transmitRate)
+// Half precision float conversion, rounding to nearest even
+// Uses the compiler's half float type where the target has one, and bit manipulation elsewhere (such as AVR).
+static uint16_t floatToHalf(float value) {
+#if defined(__ARM_FP16_FORMAT_IEEE)
+  __fp16 half = value;
+  uint16_t result;
+  memcpy(&result, &half, sizeof(result));
+  return result;
+#else
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  int16_t exponent = (int16_t)((bits >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = bits & 0x7FFFFFUL;
+  if (exponent == 0xFF - 127 + 15) {
+    // Infinity, or NaN
+    return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+  }
+  if (exponent >= 0x1F) {
+    // Too large: infinity
+    return sign | 0x7C00;
+  }
+  if (exponent <= 0) {
+    // Subnormal, or too small: zero
+    if (exponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000UL;
+    uint8_t shift = 14 - exponent;
+    uint16_t half = mantissa >> shift;
+    uint32_t rest = mantissa & ((1UL << shift) - 1);
+    uint32_t halfway = 1UL << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) {
+      half++;
+    }
+    return sign | half;
+  }
+  uint16_t half = ((uint16_t)exponent << 10) | (uint16_t)(mantissa >> 13);
+  uint16_t rest = mantissa & 0x1FFF;
+  // A carry out of the mantissa rounds up into the exponent, or to infinity
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+    half++;
+  }
+  return sign | half;
+#endif
+}
+
+static float halfToFloat(uint16_t half) {
+#if defined(__ARM_FP16_FORMAT_IEEE)
+  __fp16 value;
+  memcpy(&value, &half, sizeof(half));
+  return value;
+#else
+  uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1F;
+  uint32_t mantissa = half & 0x3FF;
+  uint32_t bits;
+  if (exponent == 0x1F) {
+    bits = sign | 0x7F800000UL | (mantissa << 13);
+  } else if (exponent == 0) {
+    if (mantissa == 0) {
+      bits = sign;
+    } else {
+      // Subnormal: normalize into a float exponent
+      exponent = 127 - 15 + 1;
+      while ((mantissa & 0x400) == 0) {
+        mantissa <<= 1;
+        exponent--;
+      }
+      bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+  } else {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+#endif
+}
+
+// Convert a stored value to type T
+// Callers check isCompatibleType first, so only conversions UP are ever performed.
+template <typename T>
+static T convertValue(DataPointType type, const DataPointValue& value) {
+  switch (type) {
+    case DataPointType::BOOLEAN: return (T)value.v_bool;
+    case DataPointType::UINT8:   return (T)value.v_uint8;
+    case DataPointType::UINT16:  return (T)value.v_uint16;
+    case DataPointType::UINT32:  return (T)value.v_uint32;
+    case DataPointType::INT8:    return (T)value.v_int8;
+    case DataPointType::INT16:   return (T)value.v_int16;
+    case DataPointType::INT32:   return (T)value.v_int32;
+    case DataPointType::FLOAT32: return (T)value.v_float32;
+    case DataPointType::FLOAT16: return (T)halfToFloat(value.v_float16);
+#if TELEMETRYJET_64BIT_TYPES
+    case DataPointType::UINT64:  return (T)value.v_uint64;
+    case DataPointType::INT64:   return (T)value.v_int64;
+#endif
+    default: return T();
+  }
+}
+
+// Sequence lock writer side, around every write to a data point's type, value, timestamp and hasValue flag
+// Writes only happen from the code that calls update(), so writers never race each other.
+static inline void beginWrite(DataPoint* point) {
+  point->version = point->version + 1;
+  TELEMETRYJET_MEMORY_BARRIER();
+}
+
+static inline void endWrite(DataPoint* point) {
+  TELEMETRYJET_MEMORY_BARRIER();
+  point->version = point->version + 1;
+}
+
+// Size of a stored value of each type, in bytes
+static uint8_t valueSize(DataPointType type) {
+  switch (type) {
+    case DataPointType::BOOLEAN: return sizeof(bool);
+    case DataPointType::UINT8:   return sizeof(uint8_t);
+    case DataPointType::UINT16:  return sizeof(uint16_t);
+    case DataPointType::UINT32:  return sizeof(uint32_t);
+    case DataPointType::INT8:    return sizeof(int8_t);
+    case DataPointType::INT16:   return sizeof(int16_t);
+    case DataPointType::INT32:   return sizeof(int32_t);
+    case DataPointType::FLOAT32: return sizeof(float);
+    case DataPointType::FLOAT16: return sizeof(uint16_t);
+#if TELEMETRYJET_64BIT_TYPES
+    case DataPointType::UINT64:  return sizeof(uint64_t);
+    case DataPointType::INT64:   return sizeof(int64_t);
+#endif
+    default: return 0;
+  }
+}
+
+// Make sure a data point has room for an array of 'size' bytes
+static bool reserveArray(DataPoint* point, uint16_t size) {
+  if (size <= point->arrayCapacity) {
+    return true;
+  }
+  void* values = malloc(size);
+  if (values == NULL) {
+    return false;
+  }
+  free(point->arrayValues);
+  point->arrayValues = values;
+  point->arrayCapacity = size;
+  return true;
+}
+
+// Make sure a data point has a scale, allocating an empty one if needed
+static bool reserveScale(DataPoint* point) {
+  if (point->scale != NULL) {
+    return true;
+  }
+  point->scale = (DataPointScale*) malloc(sizeof(DataPointScale));
+  if (point->scale == NULL) {
+    return false;
+  }
+  point->scale->minimum = 0;
+  point->scale->resolution = 0;
+  point->scale->steps = 0;
+  point->scale->announceCountdown = 0;
+  return true;
+}
+
+// Call a sampler function returning type T, and store its result
+template <typename T>
+static void callSampler(DataPointSource source, DataPointValue& value) {
+  DataPointTraits<T>::store(value, reinterpret_cast<T (*)()>(source.sampler)());
+}
+
+// Convert a stored value to another DataPointType
+static DataPointValue convertValue(DataPointType type, const DataPointValue& value, DataPointType newType) {
+  DataPointValue newValue;
+  switch (newType) {
+    case DataPointType::BOOLEAN: newValue.v_bool    = convertValue<bool>(type, value); break;
+    case DataPointType::UINT8:   newValue.v_uint8   = convertValue<uint8_t>(type, value); break;
+    case DataPointType::UINT16:  newValue.v_uint16  = convertValue<uint16_t>(type, value); break;
+    case DataPointType::UINT32:  newValue.v_uint32  = convertValue<uint32_t>(type, value); break;
+    case DataPointType::INT8:    newValue.v_int8    = convertValue<int8_t>(type, value); break;
+    case DataPointType::INT16:   newValue.v_int16   = convertValue<int16_t>(type, value); break;
+    case DataPointType::INT32:   newValue.v_int32   = convertValue<int32_t>(type, value); break;
+    case DataPointType::FLOAT32: newValue.v_float32 = convertValue<float>(type, value); break;
+    case DataPointType::FLOAT16: newValue.v_float16 = floatToHalf(convertValue<float>(type, value)); break;
+#if TELEMETRYJET_64BIT_TYPES
+    case DataPointType::UINT64:  newValue.v_uint64  = convertValue<uint64_t>(type, value); break;
+    case DataPointType::INT64:   newValue.v_int64   = convertValue<int64_t>(type, value); break;
+#endif
+    default: newValue = value; break;
+  }
+  return newValue;
+}
+
+// Bring a value written to a dimension to the dimension's type, if it is fixed (typed or bound)
+// Returns false if the value can't be converted UP to that type; it must then be dropped.
+static bool matchFixedType(const DataPoint* point, DataPointType& type, DataPointValue& value) {
+  if (!point->hasFixedType || point->type == type) {
+    return true;
+  }
+  if (!isCompatibleType(type, point->type)) {
+    return false;
+  }
+  value = convertValue(type, value, point->type);
+  type = point->type;
+  return true;
+}
+
+TelemetryJet::TelemetryJet(Stream *transport, unsigned long transmitRate, uint16_t maxFrameSize)
   : transport(transport), transmitRate(transmitRate) {
+  initialize(maxFrameSize);
+}
+
+TelemetryJet::TelemetryJet(CanDriver* driver, uint32_t baseId, uint32_t txBatchId, uint32_t rxBatchId, unsigned long transmitRate, uint16_t maxFrameSize)
+  : transport(NULL), transmitRate(transmitRate) {
+  // The channel goes in first, so the buffers are allocated once, with room for the CAN batch
+  addCanChannel(driver, baseId, txBatchId, rxBatchId);
+  initialize(maxFrameSize);
+}
+
+void TelemetryJet::initialize(uint16_t maxFrameSize) {
   // Initialize variable-size dimensions array
   dimensions = (DataPoint**) malloc(sizeof(DataPoint*) * dimensionCacheLength);
+  // One subscription bit per dimension slot; everything is subscribed until the host says otherwise
+  subscriptions = (uint8_t*) malloc(dimensionCacheLength / 8);
+  memset(subscriptions, 0xFF, dimensionCacheLength / 8);
+  tempBuffer = NULL;
+  rxBuffer = NULL;
+  txBuffer = NULL;
+  canBatch = NULL;
+  allocateBuffers(maxFrameSize);
+}
+
+bool TelemetryJet::setMaxFrameSize(uint16_t frameSize) {
+  // Send anything already queued with the old buffers before replacing them
+  flushFrame();
+  return allocateBuffers(frameSize);
+}
+
+bool TelemetryJet::allocateBuffers(uint16_t frameSize) {
+  if (frameSize < TELEMETRYJET_MIN_FRAME_SIZE) {
+    frameSize = TELEMETRYJET_MIN_FRAME_SIZE;
+  }
+  if (frameSize > TELEMETRYJET_MAX_FRAME_SIZE) {
+    frameSize = TELEMETRYJET_MAX_FRAME_SIZE;
+  }
+
+  // Largest MessagePack payload that still fits in a frame after encoding:
+  // checksum, flag byte, COBS header, frame marker, plus one COBS code byte per 254 payload bytes.
+  uint16_t payloadSize = frameSize - 4 - (frameSize / 254);
+#if TELEMETRYJET_RX
+  // Bus frames also carry the address byte
+  if (busRole != BusRole::NONE) {
+    payloadSize--;
+  }
+#endif
+
+  // All buffers share one allocation, plus the retransmit window if reliable values are used,
+  // and the batch buffer if there are CAN transports
+#if TELEMETRYJET_RX
+  const uint8_t numBuffers = 3;
+#else
+  const uint8_t numBuffers = 2;
+#endif
+  size_t windowSize = hasReliableDimension ? (size_t)payloadSize * TELEMETRYJET_RELIABLE_WINDOW : 0;
+  bool hasCanTransport = false;
+  for (uint8_t i = 0; i < numTransports; i++) {
+    hasCanTransport = hasCanTransport || transports[i]->mode == TransportMode::CAN;
+  }
+  size_t batchSize = hasCanTransport ? payloadSize : 0;
+  uint8_t* buffers = (uint8_t*) malloc((size_t)frameSize * numBuffers + windowSize + batchSize);
+  if (buffers == NULL) {
+    return false;
+  }
+
+#if TELEMETRYJET_RX
+  // Receive buffers of additional binary and CAN transports follow the frame size too
+  // They are all allocated before anything is replaced, so a failure leaves the old buffers in place.
+  uint8_t** transportBuffers = NULL;
+  if (numTransports > 0) {
+    transportBuffers = (uint8_t**) malloc(sizeof(uint8_t*) * numTransports);
+    bool isAllocated = transportBuffers != NULL;
+    for (uint8_t i = 0; i < numTransports && isAllocated; i++) {
+      transportBuffers[i] = NULL;
+    }
+    for (uint8_t i = 0; i < numTransports && isAllocated; i++) {
+      if (transports[i]->mode != TransportMode::TEXT) {
+        transportBuffers[i] = (uint8_t*) malloc(frameSize);
+        isAllocated = transportBuffers[i] != NULL;
+      }
+    }
+    if (!isAllocated) {
+      for (uint8_t i = 0; transportBuffers != NULL && i < numTransports; i++) {
+        free(transportBuffers[i]);
+      }
+      free(transportBuffers);
+      free(buffers);
+      return false;
+    }
+  }
+#endif
+
+  free(tempBuffer);
+  tempBuffer = buffers;
+  txBuffer = buffers + frameSize;
+#if TELEMETRYJET_RX
+  rxBuffer = buffers + frameSize * 2;
+#endif
+  reliableBuffer = hasReliableDimension ? buffers + (size_t)frameSize * numBuffers : NULL;
+  canBatch = hasCanTransport ? buffers + (size_t)frameSize * numBuffers + windowSize : NULL;
+  maxFrameSize = frameSize;
+  maxPayloadSize = payloadSize;
+
+#if TELEMETRYJET_RX
+  // Frames waiting in the old window are lost; the receiver will accept the restarted sequence
+  reliableTxBase = 0;
+  reliableTxNext = 0;
+  reliableTxSync = true;
+#endif
+
+  rxIndex = 0;
+  rxOverflow = false;
+  txPayloadLength = 0;
+  canBatchLength = 0;
+
+#if TELEMETRYJET_RX
+  for (uint8_t i = 0; i < numTransports; i++) {
+    free(transports[i]->rxBuffer);
+    transports[i]->rxBuffer = transportBuffers[i];
+    transports[i]->rxIndex = 0;
+    transports[i]->rxOverflow = false;
+  }
+  free(transportBuffers);
+#endif
+  return true;
+}
+
+bool TelemetryJet::addTransport(Stream* stream, TransportMode mode, unsigned long textRate) {
+#if !TELEMETRYJET_TEXT_MODE
+  if (mode == TransportMode::TEXT) {
+    return false;
+  }
+#endif
+  // CAN transports are added with a driver instead of a stream
+  if (mode == TransportMode::CAN) {
+    return false;
+  }
+  TransportChannel* channel = (TransportChannel*) malloc(sizeof(TransportChannel));
+  TransportChannel** newTransports = (TransportChannel**) malloc(sizeof(TransportChannel*) * (numTransports + 1));
+  if (channel == NULL || newTransports == NULL) {
+    free(channel);
+    free(newTransports);
+    return false;
+  }
+  memset(channel, 0, sizeof(TransportChannel));
+  channel->stream = stream;
+  channel->mode = mode;
+  channel->textRate = textRate;
+  channel->lastSent = millis();
+#if TELEMETRYJET_RX
+  if (mode == TransportMode::BINARY) {
+    channel->rxBuffer = (uint8_t*) malloc(maxFrameSize);
+    if (channel->rxBuffer == NULL) {
+      free(channel);
+      free(newTransports);
+      return false;
+    }
+  }
+#endif
+
+  // Resize transport array by one entry
+  for (uint8_t i = 0; i < numTransports; i++) {
+    newTransports[i] = transports[i];
+  }
+  free(transports);
+  transports = newTransports;
+  transports[numTransports++] = channel;
+  return true;
+}
+
+void TelemetryJet::removeTransport(Stream* stream) {
+  for (uint8_t i = 0; i < numTransports; i++) {
+    if (transports[i]->mode != TransportMode::CAN && transports[i]->stream == stream) {
+      removeTransportAt(i);
+      return;
+    }
+  }
+}
+
+void TelemetryJet::removeTransportAt(uint8_t index) {
+  free(transports[index]->rxBuffer);
+  free(transports[index]);
+  numTransports--;
+  for (uint8_t j = index; j < numTransports; j++) {
+    transports[j] = transports[j + 1];
+  }
+}
+
+bool TelemetryJet::addTransport(CanDriver* driver, uint32_t baseId, uint32_t txBatchId, uint32_t rxBatchId) {
+  if (canBatch == NULL) {
+    // The first CAN transport needs the batch buffer: queued records are sent, and the buffers allocated again
+    flushFrame();
+    if (!addCanChannel(driver, baseId, txBatchId, rxBatchId)) {
+      return false;
+    }
+    if (!allocateBuffers(maxFrameSize)) {
+      removeTransportAt(numTransports - 1);
+      return false;
+    }
+    return true;
+  }
+#if TELEMETRYJET_RX
+  uint8_t* buffer = (uint8_t*) malloc(maxFrameSize);
+  if (buffer == NULL) {
+    return false;
+  }
+  if (!addCanChannel(driver, baseId, txBatchId, rxBatchId)) {
+    free(buffer);
+    return false;
+  }
+  transports[numTransports - 1]->rxBuffer = buffer;
+  return true;
+#else
+  return addCanChannel(driver, baseId, txBatchId, rxBatchId);
+#endif
+}
+
+// Append a CAN transport, without its receive buffer
+bool TelemetryJet::addCanChannel(CanDriver* driver, uint32_t baseId, uint32_t txBatchId, uint32_t rxBatchId) {
+  TransportChannel* channel = (TransportChannel*) malloc(sizeof(TransportChannel));
+  TransportChannel** newTransports = (TransportChannel**) malloc(sizeof(TransportChannel*) * (numTransports + 1));
+  if (channel == NULL || newTransports == NULL) {
+    free(channel);
+    free(newTransports);
+    return false;
+  }
+  memset(channel, 0, sizeof(TransportChannel));
+  channel->can = driver;
+  channel->mode = TransportMode::CAN;
+  channel->lastSent = millis();
+  channel->canBaseId = baseId;
+  channel->canTxBatchId = txBatchId;
+  channel->canRxBatchId = rxBatchId;
+
+  for (uint8_t i = 0; i < numTransports; i++) {
+    newTransports[i] = transports[i];
+  }
+  free(transports);
+  transports = newTransports;
+  transports[numTransports++] = channel;
+  return true;
+}
+
+void TelemetryJet::removeTransport(CanDriver* driver) {
+  for (uint8_t i = 0; i < numTransports; i++) {
+    if (transports[i]->mode == TransportMode::CAN && transports[i]->can == driver) {
+      removeTransportAt(i);
+      return;
+    }
+  }
 }
 
 /*
@@ -55,6 +510,7 @@ size_t StuffData(const uint8_t *ptr, size_t length, uint8_t *dst) {
   return dst - start;
 }
 
+#if TELEMETRYJET_RX
 /*
  * UnStuffData decodes "length" bytes of data at
  * the location pointed to by "ptr", writing the
@@ -85,313 +541,2267 @@ size_t UnStuffData(const uint8_t *ptr, size_t length, uint8_t *dst) {
       }
   }
 
-  if (flag) {
-      --dst;
+  if (flag) {
+      --dst;
+  }
+
+  return dst - start;
+}
+#endif
+
+void TelemetryJet::update() {
+  // The frame buffers could not be allocated; there is nothing to send or receive with
+  if (tempBuffer == NULL) {
+    return;
+  }
+  if (!isInitialized) {
+    if (hasBinaryWarningMessage && !isTextMode && transport != NULL) {
+      transport->println(F("Started streaming data in Binary mode. This data is not human-readable."));
+      transport->println(F("For usage information, please see https://docs.telemetryjet.com/."));
+    }
+    isInitialized = true; 
+  }
+
+  drainPublishQueue();
+
+#if TELEMETRYJET_TEXT_MODE
+  writeTextTransports();
+  // Text mode needs the main stream; an instance serving only a CAN bus stays in binary mode
+  if (isTextMode && transport != NULL) {
+    updateTextMode();
+    return;
+  }
+#endif
+
+  // Binary mode
+#if TELEMETRYJET_RX
+  if (transport != NULL) {
+    receiveFrames(transport, rxBuffer, rxIndex, rxOverflow, &rxState);
+  }
+  for (uint8_t i = 0; i < numTransports; i++) {
+    TransportChannel* channel = transports[i];
+    if (channel->rxBuffer == NULL) {
+      continue;
+    }
+    if (channel->mode == TransportMode::BINARY) {
+      receiveFrames(channel->stream, channel->rxBuffer, channel->rxIndex, channel->rxOverflow, &channel->rxState);
+    } else if (channel->mode == TransportMode::CAN) {
+      receiveCanFrames(channel);
+    }
+  }
+#endif
+  // On a shared bus, everything else waits for this device's turn
+  bool isPolled = false;
+#if TELEMETRYJET_RX
+  if (!beginBusTurn(isPolled)) {
+    return;
+  }
+  writeAcks();
+  if (hasReadRequest) {
+    // Answer all reads from the host together, in as few frames as possible
+    hasReadRequest = false;
+    for (uint16_t i = 0; i < numDimensions; i++) {
+      if (dimensions[i]->hasReadRequest) {
+        sampleDimension(dimensions[i]);
+        updateHasValue(i);
+        if (dimensions[i]->hasValue && !writeRecord(dimensions[i])) {
+          // The rest are answered in the next bus slot
+          hasReadRequest = true;
+          break;
+        }
+        dimensions[i]->hasReadRequest = false;
+      }
+    }
+    flushFrame();
+  }
+#endif
+  if (hasUrgentValue) {
+    // Urgent values skip the transmit interval, and go out in their own frame right away
+    hasUrgentValue = false;
+#if TELEMETRYJET_RX
+    bool hasReliableValue = false;
+#endif
+    removeTransactionValues(writeTransaction());
+    for (uint16_t i = 0; i < numDimensions; i++) {
+      if (dimensions[i]->isUrgent && dimensions[i]->hasValue && dimensions[i]->hasNewTransmitValue && isSubscribed(i)) {
+        if (dimensions[i]->isReliable) {
+#if TELEMETRYJET_RX
+          hasReliableValue = true;
+#endif
+          continue;
+        }
+        dimensions[i]->hasNewTransmitValue = false;
+        if (!writeRecord(dimensions[i])) {
+          // Held for the next bus slot, and still urgent
+          dimensions[i]->hasNewTransmitValue = true;
+          hasUrgentValue = true;
+          break;
+        }
+      }
+    }
+    flushFrame();
+#if TELEMETRYJET_RX
+    if (hasReliableValue) {
+      writeReliableFrames(true);
+    }
+#endif
+  }
+  // A polled bus node sends its pending values whenever it is polled
+  if ((millis() - lastSent >= transmitRate || isPolled) && numDimensions > 0) {
+    tickCount++;
+#if TELEMETRYJET_RX
+    bool hasReliableValue = false;
+#endif
+    uint16_t numTransactionWritten = writeTransaction();
+    for (uint16_t i = 0; i < numDimensions; i++) {
+      updateHasValue(i);
+      // Skip dimensions the host has unsubscribed from, or asked for at a slower rate
+      if (!isSubscribed(i) || (tickCount % dimensions[i]->rateDivisor) != 0) {
+        continue;
+      }
+      sampleDimension(dimensions[i]);
+      if (dimensions[i]->isReliable) {
+        // Reliable values are only sent when they change, and go through the retransmit window
+#if TELEMETRYJET_RX
+        if (dimensions[i]->hasValue && dimensions[i]->hasNewTransmitValue) {
+          hasReliableValue = true;
+        }
+#endif
+        continue;
+      }
+      if (dimensions[i]->hasValue && (dimensions[i]->hasNewTransmitValue || !isDeltaMode)) {
+        // Decimated dimensions keep their pending value for a later tick
+        if (isAdaptiveRate && isDecimated(dimensions[i])) {
+          continue;
+        }
+        // Without delta mode, values just written with their transaction are not repeated
+        if (!dimensions[i]->hasNewTransmitValue && isTransactionValue(i, numTransactionWritten)) {
+          continue;
+        }
+        dimensions[i]->hasNewTransmitValue = false;
+        if (!writeRecord(dimensions[i])) {
+          // Held for the next bus slot
+          dimensions[i]->hasNewTransmitValue = true;
+          break;
+        }
+      }
+    }
+    flushFrame();
+    removeTransactionValues(numTransactionWritten);
+#if TELEMETRYJET_RX
+    if (hasReliableValue) {
+      writeReliableFrames(false);
+    }
+#endif
+    updateAdaptiveRate(millis() - lastSent);
+    lastSent = millis();
+  }
+#if TELEMETRYJET_RX
+  retransmitReliableFrames();
+#endif
+  writeWaveforms();
+#if TELEMETRYJET_RX
+  endBusTurn();
+#endif
+}
+
+#if TELEMETRYJET_TEXT_MODE
+// Text formatting
+// Values are formatted straight into a character buffer, without Print or any allocation.
+// Each function returns the number of characters written, at most TELEMETRYJET_TEXT_MAX_VALUE_LENGTH.
+
+// Write the digits of an unsigned integer; 'width' pads with leading zeros
+static uint8_t formatUInt32(char* out, uint32_t value, uint8_t width = 1) {
+  char digits[10];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + (value % 10);
+    value /= 10;
+  } while (value > 0);
+  while (count < width) {
+    digits[count++] = '0';
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    out[i] = digits[count - 1 - i];
+  }
+  return count;
+}
+
+#if TELEMETRYJET_64BIT_TYPES
+// 64-bit division is slow on small targets, so it is only used to split large values into 9-digit parts
+static uint8_t formatUInt64(char* out, uint64_t value) {
+  if (value <= 0xFFFFFFFFUL) {
+    return formatUInt32(out, (uint32_t)value);
+  }
+  uint8_t length;
+  uint32_t low = (uint32_t)(value % 1000000000UL);
+  uint64_t high = value / 1000000000UL;
+  if (high <= 0xFFFFFFFFUL) {
+    length = formatUInt32(out, (uint32_t)high);
+  } else {
+    length = formatUInt32(out, (uint32_t)(high / 1000000000UL));
+    length += formatUInt32(out + length, (uint32_t)(high % 1000000000UL), 9);
+  }
+  return length + formatUInt32(out + length, low, 9);
+}
+#endif
+
+static uint8_t formatInt32(char* out, int32_t value) {
+  if (value < 0) {
+    out[0] = '-';
+    return 1 + formatUInt32(out + 1, (uint32_t)0 - (uint32_t)value);
+  }
+  return formatUInt32(out, (uint32_t)value);
+}
+
+// Fixed-point float, with TELEMETRYJET_TEXT_DECIMALS digits after the point
+// Like Print, values beyond the 32-bit integer range are written as "ovf".
+static uint8_t formatFloat(char* out, float value) {
+  if (value != value) {
+    memcpy(out, "nan", 3);
+    return 3;
+  }
+  uint8_t length = 0;
+  if (value < 0) {
+    out[length++] = '-';
+    value = -value;
+  }
+  if (value > 4294967040.0f) {
+    memcpy(out + length, value > 3.4028235E+38f ? "inf" : "ovf", 3);
+    return length + 3;
+  }
+  uint32_t scale = 1;
+  for (uint8_t i = 0; i < TELEMETRYJET_TEXT_DECIMALS; i++) {
+    scale *= 10;
+  }
+  // Round to the last printed digit
+  value += 0.5f / scale;
+  uint32_t integer = (uint32_t)value;
+  uint32_t fraction = (uint32_t)((value - (float)integer) * scale);
+  if (fraction >= scale) {
+    fraction = scale - 1;
+  }
+  length += formatUInt32(out + length, integer);
+  if (TELEMETRYJET_TEXT_DECIMALS > 0) {
+    out[length++] = '.';
+    length += formatUInt32(out + length, fraction, TELEMETRYJET_TEXT_DECIMALS);
+  }
+  return length;
+}
+
+// Write a single value as text
+static uint8_t formatValue(char* out, DataPointType type, const DataPointValue& value) {
+  switch (type) {
+    case DataPointType::BOOLEAN: return formatUInt32(out, value.v_bool ? 1 : 0);
+    case DataPointType::UINT8:   return formatUInt32(out, value.v_uint8);
+    case DataPointType::UINT16:  return formatUInt32(out, value.v_uint16);
+    case DataPointType::UINT32:  return formatUInt32(out, value.v_uint32);
+    case DataPointType::INT8:    return formatInt32(out, value.v_int8);
+    case DataPointType::INT16:   return formatInt32(out, value.v_int16);
+    case DataPointType::INT32:   return formatInt32(out, value.v_int32);
+    case DataPointType::FLOAT32: return formatFloat(out, value.v_float32);
+    case DataPointType::FLOAT16: return formatFloat(out, halfToFloat(value.v_float16));
+#if TELEMETRYJET_64BIT_TYPES
+    case DataPointType::UINT64:  return formatUInt64(out, value.v_uint64);
+    case DataPointType::INT64: {
+      if (value.v_int64 < 0) {
+        out[0] = '-';
+        return 1 + formatUInt64(out + 1, (uint64_t)0 - (uint64_t)value.v_int64);
+      }
+      return formatUInt64(out, (uint64_t)value.v_int64);
+    }
+#endif
+    default: return 0;
+  }
+}
+
+// Append an item of 'size' characters to a text line, keeping room for the end of the line
+// If the line buffer can't hold it, the line so far is written out first. An item that doesn't fit even in an
+// empty buffer is written on its own.
+static uint16_t appendText(Print* out, char* line, uint16_t length, uint16_t bufferSize, const char* item, uint8_t size) {
+  if (length + size + 1 > bufferSize) {
+    out->write((const uint8_t*)line, length);
+    length = 0;
+    if (size + 1 > bufferSize) {
+      out->write((const uint8_t*)item, size);
+      return 0;
+    }
+  }
+  memcpy(line + length, item, size);
+  return length + size;
+}
+
+// Write the value of a data point as text, or one element of its array
+static uint8_t formatDataPoint(char* out, DataPoint* point, uint8_t index) {
+  if (point->arrayLength > 0) {
+    uint8_t size = valueSize(point->type);
+    DataPointValue element;
+    memcpy(&element, (uint8_t*)point->arrayValues + index * size, size);
+    return formatValue(out, point->type, element);
+  }
+  return formatValue(out, point->type, point->value);
+}
+
+// Write a text line to a stream, in the current text format
+// With onlyChanged, the KEY_VALUE format only prints values not sent yet; COLUMNS always prints every dimension.
+void TelemetryJet::writeTextLine(Print* out, bool onlyChanged) {
+  char* line = (char*)tempBuffer;
+  uint16_t length = 0;
+  bool hasItem = false;
+  // Each value is formatted on its own first, so the line only takes the room the value needs
+  char item[TELEMETRYJET_TEXT_MAX_KEY_LENGTH + TELEMETRYJET_TEXT_MAX_VALUE_LENGTH + 1];
+  for (uint16_t i = 0; i < numDimensions; i++) {
+    DataPoint* point = dimensions[i];
+    if (textFormat == TextFormat::KEY_VALUE) {
+      if (!point->hasValue || (onlyChanged && !point->hasNewTransmitValue)) {
+        continue;
+      }
+      // Arrays are printed as one pair per value, as key_index:value
+      uint8_t count = (point->arrayLength > 0) ? point->arrayLength : 1;
+      for (uint8_t j = 0; j < count; j++) {
+        uint8_t size = formatUInt32(item, point->key);
+        if (point->arrayLength > 0) {
+          item[size++] = '_';
+          size += formatUInt32(item + size, j);
+        }
+        item[size++] = ':';
+        size += formatDataPoint(item + size, point, j);
+        item[size++] = ' ';
+        length = appendText(out, line, length, maxFrameSize, item, size);
+        hasItem = true;
+      }
+    } else {
+      // Arrays are printed as one column per value
+      uint8_t count = (point->hasValue && point->arrayLength > 0) ? point->arrayLength : 1;
+      for (uint8_t j = 0; j < count; j++) {
+        uint8_t size = 0;
+        if (point->hasValue) {
+          size = formatDataPoint(item, point, j);
+        } else {
+          item[size++] = '0';
+        }
+        item[size++] = ' ';
+        length = appendText(out, line, length, maxFrameSize, item, size);
+        hasItem = true;
+      }
+    }
+  }
+  if (!hasItem && textFormat == TextFormat::KEY_VALUE) {
+    // Nothing changed
+    return;
+  }
+  line[length++] = '\n';
+  out->write((const uint8_t*)line, length);
+}
+
+// Text mode
+// Don't read inputs; just log as text output to the serial stream
+// Useful for debugging purposes
+// Each line is built in the (otherwise idle) frame buffer, and written with a single write() when it fits in
+// the buffer. A longer line is written in parts of up to maxFrameSize characters.
+void TelemetryJet::updateTextMode() {
+  while (transport->available() > 0) {
+    transport->read();
+  }
+
+  if (millis() - lastSent >= transmitRate && numDimensions > 0) {
+    bool hasChange = false;
+    for (uint16_t i = 0; i < numDimensions; i++) {
+      sampleDimension(dimensions[i]);
+      updateHasValue(i);
+      if (dimensions[i]->hasNewTransmitValue) {
+        hasChange = true;
+      }
+    }
+
+    // In delta mode, the KEY_VALUE format only prints changed values, unless a full line is due
+    bool isFullLine = !isDeltaMode;
+    if (textFormat == TextFormat::KEY_VALUE && textFullLineInterval > 0) {
+      isFullLine = isFullLine || textLinesSinceFull == 0;
+      textLinesSinceFull = (textLinesSinceFull + 1) % textFullLineInterval;
+    }
+    if (hasChange || isFullLine) {
+      writeTextLine(transport, !isFullLine);
+    }
+
+    for (uint16_t i = 0; i < numDimensions; i++) {
+      dimensions[i]->hasNewTransmitValue = false;
+    }
+    // Committed transaction values were printed with the rest
+    removeTransactionValues(countCommittedValues());
+    lastSent = millis();
+  }
+}
+
+// Print every value to the additional text transports that are due
+// Their lines don't consume new values, so the main transport still sends them. Bound dimensions are sampled
+// first, so lines show current values even for dimensions the binary link hasn't sampled lately.
+void TelemetryJet::writeTextTransports() {
+  for (uint8_t i = 0; i < numTransports; i++) {
+    TransportChannel* channel = transports[i];
+    if (channel->mode != TransportMode::TEXT) {
+      continue;
+    }
+    while (channel->stream->available() > 0) {
+      channel->stream->read();
+    }
+    if (millis() - channel->lastSent >= channel->textRate && numDimensions > 0) {
+      // The line is built in the frame buffer, so send any records still waiting there
+      flushFrame();
+      for (uint16_t j = 0; j < numDimensions; j++) {
+        sampleDimension(dimensions[j]);
+        updateHasValue(j);
+      }
+      writeTextLine(channel->stream, false);
+      channel->lastSent = millis();
+    }
+  }
+}
+#endif
+
+#if TELEMETRYJET_RX
+// Read a single value of the given type
+// Returns false if the type is unknown; the value is skipped.
+static bool readValue(mpack_reader_t* reader, DataPointType type, DataPointValue* value) {
+  switch (type) {
+    case DataPointType::BOOLEAN: {
+      value->v_bool = mpack_expect_bool(reader);
+      break;
+    }
+    case DataPointType::UINT8: {
+      value->v_uint8 = mpack_expect_u8(reader);
+      break;
+    }
+    case DataPointType::UINT16: {
+      value->v_uint16 = mpack_expect_u16(reader);
+      break;
+    }
+    case DataPointType::UINT32: {
+      value->v_uint32 = mpack_expect_u32(reader);
+      break;
+    }
+#if TELEMETRYJET_64BIT_TYPES
+    case DataPointType::UINT64: {
+      value->v_uint64 = mpack_expect_u64(reader);
+      break;
+    }
+#endif
+    case DataPointType::INT8: {
+      value->v_int8 = mpack_expect_i8(reader);
+      break;
+    }
+    case DataPointType::INT16: {
+      value->v_int16 = mpack_expect_i16(reader);
+      break;
+    }
+    case DataPointType::INT32: {
+      value->v_int32 = mpack_expect_i32(reader);
+      break;
+    }
+#if TELEMETRYJET_64BIT_TYPES
+    case DataPointType::INT64: {
+      value->v_int64 = mpack_expect_i64(reader);
+      break;
+    }
+#endif
+    case DataPointType::FLOAT32: {
+      value->v_float32 = mpack_expect_float(reader);
+      break;
+    }
+    case DataPointType::FLOAT16: {
+      // Sent as the 16 bits of the half precision value
+      value->v_float16 = mpack_expect_u16(reader);
+      break;
+    }
+    default: {
+      // Unknown record type from a newer sender, or a type compiled out of this build;
+      // skip its value and keep reading
+      mpack_discard(reader);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Read all available bytes from a transport, and decode each complete frame
+// Each transport has its own buffer, position and receive state, so frames arriving on several transports don't mix.
+void TelemetryJet::receiveFrames(Stream* stream, uint8_t* buffer, uint16_t& index, bool& overflow, ReceiveState* state) {
+  while (stream->available() > 0) {
+    uint8_t inByte = stream->read();
+    linkStatistics.rxBytes++;
+
+    // 0x0 pads the end of a packet
+    // Reset the buffer and parse if possible
+    if (inByte == 0x0) {
+      if (overflow) {
+        // Frame was longer than the receive buffer; the tail of it ends here
+        linkStatistics.rxDroppedOverflow++;
+      } else {
+        buffer[index++] = inByte;
+        if (!routeFrame(stream, buffer, index)) {
+          readFrame(stream, buffer, index, state);
+        }
+      }
+      index = 0;
+      overflow = false;
+      continue;
+    }
+
+    if (overflow) {
+      continue;
+    }
+    // Always leave room for the frame marker
+    if (index >= maxFrameSize - 1) {
+      overflow = true;
+      continue;
+    }
+    buffer[index++] = inByte;
+  }
+}
+
+bool TelemetryJet::addRoute(Stream* from, Stream* to, uint16_t firstKey, uint16_t lastKey) {
+  // Resize route array by one entry
+  FrameRoute* newRoutes = (FrameRoute*) malloc(sizeof(FrameRoute) * (numRoutes + 1));
+  if (newRoutes == NULL) {
+    return false;
+  }
+  if (numRoutes > 0) {
+    memcpy(newRoutes, routes, sizeof(FrameRoute) * numRoutes);
+  }
+  free(routes);
+  routes = newRoutes;
+  routes[numRoutes].from = from;
+  routes[numRoutes].to = to;
+  routes[numRoutes].firstKey = firstKey;
+  routes[numRoutes].lastKey = lastKey;
+  numRoutes++;
+  return true;
+}
+
+void TelemetryJet::clearRoutes() {
+  free(routes);
+  routes = NULL;
+  numRoutes = 0;
+}
+
+bool TelemetryJet::setBusNode(uint8_t address, BusSchedule schedule) {
+  if (transport == NULL || address < 1 || address > TELEMETRYJET_BUS_MAX_ADDRESS) {
+    return false;
+  }
+  flushFrame();
+  free(busNodeStates);
+  busNodeStates = NULL;
+  busRole = BusRole::NODE;
+  busSchedule = schedule;
+  busAddress = address;
+  hasBusSync = false;
+  hasBusPoll = false;
+  // The startup message would collide with other devices on the bus
+  hasBinaryWarningMessage = false;
+  return allocateBuffers(maxFrameSize);
+}
+
+bool TelemetryJet::setBusMaster(BusSchedule schedule, uint8_t numNodes, uint16_t slotLength) {
+  if (transport == NULL || numNodes < 1 || numNodes > TELEMETRYJET_BUS_MAX_ADDRESS || slotLength == 0) {
+    return false;
+  }
+  ReceiveState* nodeStates = (ReceiveState*) malloc(sizeof(ReceiveState) * numNodes);
+  if (nodeStates == NULL) {
+    return false;
+  }
+  memset(nodeStates, 0, sizeof(ReceiveState) * numNodes);
+  flushFrame();
+  free(busNodeStates);
+  busNodeStates = nodeStates;
+  busRole = BusRole::MASTER;
+  busSchedule = schedule;
+  busNumNodes = numNodes;
+  busSlotLength = slotLength;
+  busNextPoll = 1;
+  // Start the first cycle or poll at the next update()
+  busCycleStart = millis() - (uint32_t)slotLength * (numNodes + 1);
+  hasBinaryWarningMessage = false;
+  return allocateBuffers(maxFrameSize);
+}
+
+void TelemetryJet::setBusDirectionPin(int pin) {
+  busDirectionPin = pin;
+  if (pin >= 0) {
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+  }
+}
+
+// Check whether this device may transmit now, and start the master's cycle or poll when it is due
+// isPolled is set when a polled node should send its pending values right away.
+bool TelemetryJet::beginBusTurn(bool& isPolled) {
+  busTurnBytes = 0xFFFF;
+  uint32_t slotElapsed = 0;
+  switch (busRole) {
+    case BusRole::NODE: {
+      if (busSchedule == BusSchedule::POLLED) {
+        isPolled = hasBusPoll;
+        return hasBusPoll;
+      }
+      if (!hasBusSync) {
+        return false;
+      }
+      uint32_t cycleLength = (uint32_t)busSlotLength * (busNumNodes + 1);
+      uint32_t cycleElapsed = (millis() - busCycleStart) % cycleLength;
+      if (cycleElapsed / busSlotLength != busAddress) {
+        return false;
+      }
+      slotElapsed = cycleElapsed % busSlotLength;
+      break;
+    }
+    case BusRole::MASTER: {
+      uint32_t elapsed = millis() - busCycleStart;
+      if (busSchedule == BusSchedule::POLLED) {
+        // The master sends its own values just before each poll
+        isBusPollDue = elapsed >= busSlotLength;
+        if (isBusPollDue) {
+          busCycleStart = millis();
+        }
+        return isBusPollDue;
+      }
+      if (elapsed >= (uint32_t)busSlotLength * (busNumNodes + 1)) {
+        busCycleStart = millis();
+        elapsed = 0;
+        writeControlRecord(busNumNodes, ControlType::BUS_SYNC, busSlotLength);
+        flushFrame();
+      }
+      if (elapsed >= busSlotLength) {
+        return false;
+      }
+      slotElapsed = elapsed;
+      break;
+    }
+    default: {
+      return true;
+    }
+  }
+
+  // In a slot, only as many bytes as the bus can carry before the guard time at the end of the slot,
+  // after the bytes this device has written but are still being sent
+  int32_t remaining = (int32_t)(busSlotLength - slotElapsed - TELEMETRYJET_BUS_GUARD_TIME) * 1000;
+  int32_t sending = (int32_t)(busTxEnd - micros());
+  if (sending > 0) {
+    remaining -= sending;
+  }
+  if (remaining <= 0) {
+    busTurnBytes = 0;
+  } else {
+    // 10 bits per byte on the wire, with the start and stop bits; long slots are capped to stay within 32 bits
+    uint32_t bytes = (uint32_t)((remaining < 4000000L) ? remaining : 4000000L) / 100 * (busBaudRate / 100) / 1000;
+    busTurnBytes = (bytes < 0xFFFF) ? bytes : 0xFFFF;
+  }
+  return true;
+}
+
+// Largest payload whose frame still fits in the rest of this device's bus slot, at most maxPayloadSize
+uint16_t TelemetryJet::getBusTurnPayloadSize() {
+  if (busTurnBytes >= maxFrameSize) {
+    return maxPayloadSize;
+  }
+  // Same overhead as in allocateBuffers, with the address byte
+  if (busTurnBytes <= 5) {
+    return 0;
+  }
+  return busTurnBytes - 5 - (busTurnBytes / 254);
+}
+
+// Hand the bus over at the end of this device's turn
+void TelemetryJet::endBusTurn() {
+  busTurnBytes = 0xFFFF;
+  if (busRole == BusRole::NODE) {
+    hasBusPoll = false;
+  } else if (busRole == BusRole::MASTER && isBusPollDue) {
+    isBusPollDue = false;
+    writeControlRecord(busNextPoll, ControlType::BUS_POLL, 0);
+    flushFrame();
+    busNextPoll = (busNextPoll >= busNumNodes) ? 1 : busNextPoll + 1;
+  }
+}
+
+// Move the checksum of a frame by 'delta', keeping it off 0, the frame marker
+// The checksum correction in the low 2 bits of the flag byte takes up the difference, and stays 0b01 or 0b10.
+static void adjustChecksum(uint8_t* header, uint8_t delta) {
+  header[0] += delta;
+  if (header[0] == 0) {
+    if ((header[1] & 0x03) == 0x01) {
+      header[0] = 0xFF;
+      header[1]++;
+    } else {
+      header[0] = 0x01;
+      header[1]--;
+    }
+  }
+}
+
+// Forward a frame as it was received, adding or removing the address byte between the bus and other transports
+void TelemetryJet::writeRoutedFrame(Stream* from, Stream* to, const uint8_t* frame, uint16_t length) {
+  bool isFromBus = isBusStream(from);
+  if (isFromBus == isBusStream(to)) {
+    to->write(frame, length);
+    return;
+  }
+  uint8_t header[3] = { frame[0], frame[1], 0 };
+  if (isFromBus) {
+    // Every byte counts towards the checksum, so it takes over the address byte's share
+    adjustChecksum(header, frame[2]);
+    to->write(header, 2);
+    to->write(frame + 3, length - 3);
+  } else {
+    header[2] = (busRole == BusRole::MASTER) ? (TELEMETRYJET_BUS_MASTER_FLAG | TELEMETRYJET_BUS_BROADCAST) : busAddress;
+    adjustChecksum(header, -header[2]);
+    to->write(header, 3);
+    to->write(frame + 2, length - 2);
+  }
+}
+
+// Forward a received frame along every matching route, exactly as it was received
+// Returns true if the frame was forwarded, in which case it isn't read here.
+bool TelemetryJet::routeFrame(Stream* from, const uint8_t* frame, uint16_t length) {
+  if (numRoutes == 0 || length < 7) {
+    return false;
+  }
+  uint8_t checksum = 0;
+  for (uint16_t i = 0; i < length; i++) {
+    checksum += frame[i];
+  }
+  if (checksum != 0xFF) {
+    return false;
+  }
+
+  // Decode just enough of the COBS data for the key and type of the first record, without changing the frame
+  uint8_t head[6];
+  uint8_t headLength = 0;
+  uint16_t i = isBusStream(from) ? 3 : 2;
+  while (i < length - 1 && headLength < sizeof(head)) {
+    uint8_t code = frame[i++];
+    for (uint8_t j = 1; j < code && i < length - 1 && headLength < sizeof(head); j++) {
+      head[headLength++] = frame[i++];
+    }
+    if (code < 0xFF && headLength < sizeof(head)) {
+      head[headLength++] = 0;
+    }
+  }
+  mpack_reader_t reader;
+  mpack_reader_init_data(&reader, (const char*)head, headLength);
+  uint16_t key = mpack_expect_u16(&reader);
+  uint8_t type = mpack_expect_u8(&reader);
+  bool isValid = mpack_reader_destroy(&reader) == mpack_ok;
+  bool isControl = type >= TELEMETRYJET_CONTROL_TYPE_BASE;
+
+  bool isForwarded = false;
+  for (uint8_t r = 0; r < numRoutes; r++) {
+    FrameRoute* route = &routes[r];
+    if (route->from != from) {
+      continue;
+    }
+    bool isFullRange = route->firstKey == 0 && route->lastKey == 0xFFFF;
+    if (!isFullRange && (!isValid || isControl || key < route->firstKey || key > route->lastKey)) {
+      continue;
+    }
+    writeRoutedFrame(from, route->to, frame, length);
+    isForwarded = true;
+  }
+  if (isForwarded) {
+    linkStatistics.rxForwardedFrames++;
+  }
+  return isForwarded;
+}
+
+// Validate and decode a received frame, from the checksum byte up to and including the frame marker
+void TelemetryJet::readFrame(Stream* from, uint8_t* frame, uint16_t length, ReceiveState* state) {
+  // Minimum length of a packet is 7 bytes:
+  // - Checksum (1 byte)
+  // - Checksum correction byte (1 byte)
+  // - COBS header byte (1 byte)
+  // - Key (1+ byte)
+  // - Type (1+ byte)
+  // - Value (1+ byte)
+  // - Packet boundary (0x0, 1 byte)
+  if (length < 7) {
+    return;
+  }
+
+  // 1 - Validate checksum
+  uint8_t checksum = 0;
+  for (uint16_t bufferIdx = 0; bufferIdx < length; bufferIdx++) {
+    checksum += frame[bufferIdx];
+  }
+  if (checksum != 0xFF) {
+    linkStatistics.rxDroppedChecksum++;
+    return;
+  }
+
+  // On a bus, nodes only read frames from the master, addressed to every node or to themselves, and the master only
+  // reads frames from its nodes. Each node numbers its frames separately, so the master tracks them by address.
+  // Frames on other transports have no address byte, and are read as usual.
+  bool isBusFrame = isBusStream(from);
+  uint8_t headerLength = isBusFrame ? 3 : 2;
+  if (isBusFrame) {
+    uint8_t address = frame[2];
+    bool isFromMaster = (address & TELEMETRYJET_BUS_MASTER_FLAG) != 0;
+    if (busRole == BusRole::MASTER) {
+      if (isFromMaster || address < 1 || address > busNumNodes) {
+        return;
+      }
+      state = &busNodeStates[address - 1];
+    } else {
+      uint8_t destination = address & ~TELEMETRYJET_BUS_MASTER_FLAG;
+      if (!isFromMaster || (destination != TELEMETRYJET_BUS_BROADCAST && destination != busAddress)) {
+        return;
+      }
+    }
+  }
+  updateRxSequence(state, frame[1] >> 2);
+
+  // 2 - Expand COBS encoded binary string
+  // Offset the array by the checksum bytes and bus address that are not contained in the cobs encoding
+  // Decoding never writes ahead of the read position, so it can run in place.
+  size_t packetLength = UnStuffData(frame + headerLength, length - headerLength, frame + headerLength);
+
+  // 3 - Process messagepack records
+  readPayload(frame + headerLength, packetLength, state);
+}
+
+// Decode the MessagePack records of a frame
+// A frame holds one or more (key, type, value) records back to back.
+void TelemetryJet::readPayload(const uint8_t* payload, size_t length, ReceiveState* state) {
+  mpack_reader_t reader;
+  mpack_reader_init_data(&reader, (const char*)payload, length);
+
+  // Control records can mark the rest of a frame to be skipped, such as a repeated reliable frame
+  bool acceptRecords = true;
+  while (mpack_reader_remaining(&reader, NULL) > 0 && mpack_reader_error(&reader) == mpack_ok) {
+    uint16_t key = mpack_expect_u16(&reader);
+    uint8_t type = mpack_expect_u8(&reader);
+    DataPointValue value;
+
+    if (type >= TELEMETRYJET_CONTROL_TYPE_BASE) {
+      uint32_t controlValue = mpack_expect_u32(&reader);
+      if (mpack_reader_error(&reader) == mpack_ok && acceptRecords) {
+        acceptRecords = receiveControlRecord(key, (ControlType)type, controlValue, state);
+      }
+      continue;
+    }
+
+    if (type & TELEMETRYJET_ARRAY_TYPE_FLAG) {
+      // Array records are decoded straight into the array storage of their dimension
+      DataPointType elementType = (DataPointType)(type & ~TELEMETRYJET_ARRAY_TYPE_FLAG);
+      uint8_t arrayLength = mpack_expect_array_max(&reader, TELEMETRYJET_MAX_ARRAY_LENGTH);
+      uint8_t size = valueSize(elementType);
+      uint16_t id;
+      for (id = 0; id < numDimensions; id++) {
+        if (dimensions[id]->key == key) {
+          break;
+        }
+      }
+      // Bound dimensions hold a single value, and typed dimensions only take arrays of their own type
+      bool isAccepted = acceptRecords && id < numDimensions && size > 0 && arrayLength > 0;
+      if (isAccepted) {
+        bool isFixedMismatch = dimensions[id]->hasFixedType && dimensions[id]->type != elementType;
+        isAccepted = dimensions[id]->binding == DataPointBinding::NONE && !isFixedMismatch;
+      }
+      DataPoint* point = NULL;
+      if (isAccepted && reserveArray(dimensions[id], arrayLength * size)) {
+        point = dimensions[id];
+        beginWrite(point);
+      }
+      for (uint8_t i = 0; i < arrayLength; i++) {
+        if (readValue(&reader, elementType, &value) && point != NULL) {
+          memcpy((uint8_t*)point->arrayValues + i * size, &value, size);
+        }
+      }
+      mpack_done_array(&reader);
+      if (point != NULL) {
+        point->type = elementType;
+        point->arrayLength = arrayLength;
+        point->lastTimestamp = millis();
+        point->hasValue = mpack_reader_error(&reader) == mpack_ok;
+        endWrite(point);
+        if (point->hasValue) {
+          notifyReceived(id);
+        }
+      }
+      continue;
+    }
+
+    if (type == TELEMETRYJET_SCALE_TYPE || type == TELEMETRYJET_SCALED_VALUE_TYPE) {
+      // Scaled values are received as FLOAT32 values, once the scale of their key is known
+      uint16_t id;
+      for (id = 0; id < numDimensions; id++) {
+        if (dimensions[id]->key == key) {
+          break;
+        }
+      }
+      if (type == TELEMETRYJET_SCALE_TYPE) {
+        mpack_expect_array_match(&reader, 2);
+        float minimum = mpack_expect_float(&reader);
+        float resolution = mpack_expect_float(&reader);
+        mpack_done_array(&reader);
+        if (mpack_reader_error(&reader) == mpack_ok && acceptRecords && id < numDimensions && resolution > 0 && reserveScale(dimensions[id])) {
+          dimensions[id]->scale->minimum = minimum;
+          dimensions[id]->scale->resolution = resolution;
+        }
+      } else {
+        uint32_t steps = mpack_expect_u32(&reader);
+        if (mpack_reader_error(&reader) == mpack_ok && acceptRecords && id < numDimensions && dimensions[id]->scale != NULL) {
+          value.v_float32 = dimensions[id]->scale->minimum + steps * dimensions[id]->scale->resolution;
+          receiveRecord(key, DataPointType::FLOAT32, value);
+        }
+      }
+      continue;
+    }
+
+    bool isKnownType = readValue(&reader, (DataPointType)type, &value);
+
+    if (mpack_reader_error(&reader) == mpack_ok && isKnownType && acceptRecords) {
+      receiveRecord(key, (DataPointType)type, value);
+    }
+  }
+
+  if (mpack_reader_destroy(&reader) == mpack_ok) {
+    linkStatistics.rxFrames++;
+    state->statistics.rxFrames++;
+  } else {
+    linkStatistics.rxDroppedDecode++;
+  }
+}
+
+// Read every frame waiting on a CAN transport
+// Frames with IDs outside of the transport's key range and batch IDs belong to other devices, and are ignored.
+void TelemetryJet::receiveCanFrames(TransportChannel* channel) {
+  uint32_t id;
+  uint8_t data[8];
+  uint8_t length;
+  while (channel->can->read(&id, data, &length)) {
+    if (length > 8) {
+      continue;
+    }
+    if (id == channel->canRxBatchId) {
+      linkStatistics.rxBytes += length;
+      receiveCanSegment(channel, data, length);
+      continue;
+    }
+    if (id == channel->canTxBatchId || id < channel->canBaseId || id - channel->canBaseId > 0xFFFF) {
+      continue;
+    }
+    linkStatistics.rxBytes += length;
+
+    // A single value: its type, then its raw little-endian bytes
+    DataPointType type = (DataPointType)data[0];
+    uint8_t size = valueSize(type);
+    if (length < 2 || size != length - 1) {
+      linkStatistics.rxDroppedDecode++;
+      continue;
+    }
+    uint32_t bits = 0;
+    for (uint8_t i = 0; i < size; i++) {
+      bits |= (uint32_t)data[1 + i] << (8 * i);
+    }
+    DataPointValue value;
+    if (type == DataPointType::BOOLEAN) {
+      value.v_bool = bits != 0;
+    } else if (size == 1) {
+      value.v_uint8 = bits;
+    } else if (size == 2) {
+      value.v_uint16 = bits;
+    } else {
+      value.v_uint32 = bits;
+    }
+    linkStatistics.rxFrames++;
+    channel->rxState.statistics.rxFrames++;
+    receiveRecord(id - channel->canBaseId, type, value);
+  }
+}
+
+// Reassemble a batch from its segments, laid out like ISO 15765-2 (ISO-TP) without flow control:
+// a single frame (0x0L), or a first frame (0x1L LL) followed by consecutive frames (0x2N) numbered from 1.
+// Batches are broadcast, so a missing segment drops the whole batch.
+void TelemetryJet::receiveCanSegment(TransportChannel* channel, const uint8_t* data, uint8_t length) {
+  if (length < 1) {
+    return;
+  }
+  uint8_t frameType = data[0] >> 4;
+  if (frameType == 0x0) {
+    uint8_t batchLength = data[0] & 0x0F;
+    if (batchLength > 0 && batchLength < length) {
+      readPayload(data + 1, batchLength, &channel->rxState);
+    }
+    return;
+  }
+  if (frameType == 0x1) {
+    if (channel->rxBatchLength > 0) {
+      linkStatistics.rxDroppedDecode++;
+    }
+    uint16_t batchLength = ((uint16_t)(data[0] & 0x0F) << 8) | (length > 1 ? data[1] : 0);
+    channel->rxBatchLength = 0;
+    if (length < 2 || batchLength <= 7) {
+      linkStatistics.rxDroppedDecode++;
+      return;
+    }
+    if (batchLength > maxFrameSize) {
+      linkStatistics.rxDroppedOverflow++;
+      return;
+    }
+    channel->rxIndex = length - 2;
+    memcpy(channel->rxBuffer, data + 2, channel->rxIndex);
+    channel->rxBatchLength = batchLength;
+    channel->rxBatchSequence = 1;
+    return;
+  }
+  if (frameType == 0x2 && channel->rxBatchLength > 0) {
+    if ((data[0] & 0x0F) != channel->rxBatchSequence) {
+      linkStatistics.rxDroppedDecode++;
+      channel->rxBatchLength = 0;
+      return;
+    }
+    uint16_t count = length - 1;
+    if (count > channel->rxBatchLength - channel->rxIndex) {
+      count = channel->rxBatchLength - channel->rxIndex;
+    }
+    memcpy(channel->rxBuffer + channel->rxIndex, data + 1, count);
+    channel->rxIndex += count;
+    channel->rxBatchSequence = (channel->rxBatchSequence + 1) & 0x0F;
+    if (channel->rxIndex >= channel->rxBatchLength) {
+      channel->rxBatchLength = 0;
+      readPayload(channel->rxBuffer, channel->rxIndex, &channel->rxState);
+    }
+  }
+}
+
+// Write a received value into the dimension with a matching key
+void TelemetryJet::receiveRecord(uint16_t key, DataPointType type, DataPointValue value) {
+  if (rxQueueSize > 0) {
+    if (rxQueueLength < rxQueueSize) {
+      ReceiveEvent* event = &rxQueue[(rxQueueHead + rxQueueLength) % rxQueueSize];
+      event->key = key;
+      event->type = type;
+      event->value = value;
+      event->timestamp = millis();
+      rxQueueLength++;
+    } else {
+      linkStatistics.rxQueueOverflows++;
+    }
+  }
+
+  for (uint16_t i = 0; i < numDimensions; i++) {
+    if (dimensions[i]->key == key) {
+      // Typed and bound dimensions keep their type, so values of another type are converted, or dropped if they don't fit
+      if (!matchFixedType(dimensions[i], type, value)) {
+        break;
+      }
+      bool isBoundVariable = dimensions[i]->binding == DataPointBinding::VARIABLE;
+      beginWrite(dimensions[i]);
+      dimensions[i]->value = value;
+      dimensions[i]->type = type;
+      dimensions[i]->arrayLength = 0;
+      dimensions[i]->lastTimestamp = millis();
+      dimensions[i]->hasValue = true;
+      endWrite(dimensions[i]);
+      if (isBoundVariable) {
+        memcpy(dimensions[i]->source.variable, &value, valueSize(type));
+      }
+      notifyReceived(i);
+      break;
+    }
+  }
+}
+
+// Update flags for a value that was just received, and dispatch receive callbacks
+void TelemetryJet::notifyReceived(uint16_t id) {
+  dimensions[id]->hasNewTransmitValue = false;
+  dimensions[id]->hasNewReceivedValue = true;
+  if (dimensions[id]->receiveCallback != NULL) {
+    dimensions[id]->receiveCallback(Dimension(id, this));
+  }
+  if (receiveCallback != NULL) {
+    receiveCallback(Dimension(id, this));
+  }
+}
+
+bool TelemetryJet::setReceiveQueueSize(uint8_t size) {
+  ReceiveEvent* queue = NULL;
+  if (size > 0) {
+    queue = (ReceiveEvent*) malloc(sizeof(ReceiveEvent) * size);
+    if (queue == NULL) {
+      return false;
+    }
+  }
+  // Values still in the old queue are discarded
+  free(rxQueue);
+  rxQueue = queue;
+  rxQueueSize = size;
+  rxQueueHead = 0;
+  rxQueueLength = 0;
+  return true;
+}
+
+bool TelemetryJet::readReceiveEvent(ReceiveEvent* event) {
+  if (rxQueueLength == 0) {
+    return false;
+  }
+  *event = rxQueue[rxQueueHead];
+  rxQueueHead = (rxQueueHead + 1) % rxQueueSize;
+  rxQueueLength--;
+  return true;
+}
+
+bool TelemetryJet::onReceive(uint16_t key, ReceiveCallback callback) {
+  for (uint16_t i = 0; i < numDimensions; i++) {
+    if (dimensions[i]->key == key) {
+      dimensions[i]->receiveCallback = callback;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Handle a control record from a received frame
+// Returns false if the remaining records in the frame should be skipped.
+bool TelemetryJet::receiveControlRecord(uint16_t key, ControlType type, uint32_t value, ReceiveState* state) {
+  switch (type) {
+    case ControlType::RELIABLE: {
+      // Go-back-N receiver: only the next frame in order is accepted.
+      // Anything else is a repeat or arrived after a lost frame, and is skipped.
+      // Either way, the ACK tells the sender where to resume.
+      // The first reliable frame seen, or the first frame from a restarted sender, sets a new starting point.
+      state->hasReliableAck = true;
+      bool isSenderRestart = (value != 0) && (key == 0) && (state->reliableRxExpected != 1);
+      if (key == state->reliableRxExpected || !state->hasReliableRxSequence || isSenderRestart) {
+        state->hasReliableRxSequence = true;
+        state->reliableRxExpected = key + 1;
+        return true;
+      }
+      linkStatistics.rxReliableDiscarded++;
+      return false;
+    }
+    case ControlType::ACK: {
+      // Cumulative ACK: frees every frame up to and including this sequence number
+      uint16_t acked = key - reliableTxBase;
+      if (acked < (uint16_t)(reliableTxNext - reliableTxBase)) {
+        reliableTxBase = key + 1;
+        reliableTxSync = false;
+      }
+      return true;
+    }
+    case ControlType::SUBSCRIBE:
+    case ControlType::UNSUBSCRIBE: {
+      // Key range from the record key up to the record value, inclusive
+      for (uint16_t i = 0; i < numDimensions; i++) {
+        if (dimensions[i]->key >= key && dimensions[i]->key <= value) {
+          setSubscribed(i, type == ControlType::SUBSCRIBE);
+        }
+      }
+      return true;
+    }
+    case ControlType::SET_RATE: {
+      // Rates are rounded up to a whole number of transmit intervals
+      uint32_t divisor = (transmitRate > 0) ? (value + transmitRate - 1) / transmitRate : 1;
+      if (divisor < 1) {
+        divisor = 1;
+      }
+      if (divisor > 255) {
+        divisor = 255;
+      }
+      for (uint16_t i = 0; i < numDimensions; i++) {
+        if (dimensions[i]->key == key) {
+          dimensions[i]->rateDivisor = divisor;
+        }
+      }
+      return true;
+    }
+    case ControlType::READ: {
+      for (uint16_t i = 0; i < numDimensions; i++) {
+        if (dimensions[i]->key >= key && dimensions[i]->key <= value) {
+          dimensions[i]->hasReadRequest = true;
+          hasReadRequest = true;
+        }
+      }
+      return true;
+    }
+    case ControlType::BUS_SYNC: {
+      // The master started a slot cycle; slots are timed from when the sync arrives
+      if (busRole == BusRole::NODE) {
+        busNumNodes = key;
+        busSlotLength = value;
+        busCycleStart = millis();
+        hasBusSync = busSlotLength > 0;
+      }
+      return true;
+    }
+    case ControlType::BUS_POLL: {
+      if (busRole == BusRole::NODE && key == busAddress) {
+        hasBusPoll = true;
+      }
+      return true;
+    }
+    default: {
+      // Unknown control record from a newer sender
+      return true;
+    }
+  }
+}
+
+#endif
+
+// Write a single value of the given type
+static void writeValue(mpack_writer_t* writer, DataPointType type, const DataPointValue& value) {
+  switch (type) {
+    case DataPointType::BOOLEAN: {
+      mpack_write_bool(writer, value.v_bool);
+      break;
+    }
+    case DataPointType::UINT8: {
+      mpack_write_u8(writer, value.v_uint8);
+      break;
+    }
+    case DataPointType::UINT16: {
+      mpack_write_u16(writer, value.v_uint16);
+      break;
+    }
+    case DataPointType::UINT32: {
+      mpack_write_u32(writer, value.v_uint32);
+      break;
+    }
+#if TELEMETRYJET_64BIT_TYPES
+    case DataPointType::UINT64: {
+      mpack_write_u64(writer, value.v_uint64);
+      break;
+    }
+#endif
+    case DataPointType::INT8: {
+      mpack_write_i8(writer, value.v_int8);
+      break;
+    }
+    case DataPointType::INT16: {
+      mpack_write_i16(writer, value.v_int16);
+      break;
+    }
+    case DataPointType::INT32: {
+      mpack_write_i32(writer, value.v_int32);
+      break;
+    }
+#if TELEMETRYJET_64BIT_TYPES
+    case DataPointType::INT64: {
+      mpack_write_i64(writer, value.v_int64);
+      break;
+    }
+#endif
+    case DataPointType::FLOAT32: {
+      mpack_write_float(writer, value.v_float32);
+      break;
+    }
+    case DataPointType::FLOAT16: {
+      mpack_write_u16(writer, value.v_float16);
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+// Encode the (key, type, value) record of a data point into a buffer
+// Returns the encoded length, or 0 if the record doesn't fit.
+static size_t encodeRecord(DataPoint* point, uint8_t* buffer, size_t bufferSize) {
+  mpack_writer_t writer;
+  mpack_writer_init(&writer, (char*)buffer, bufferSize);
+
+  DataPointScale* scale = point->scale;
+  bool isScaled = scale != NULL && scale->steps > 0 && point->type == DataPointType::FLOAT32 && point->arrayLength == 0;
+  if (isScaled && scale->announceCountdown == 0) {
+    // Tell the receiver how to read the scaled values of this key
+    mpack_write_u16(&writer, (uint16_t)point->key);
+    mpack_write_u8(&writer, TELEMETRYJET_SCALE_TYPE);
+    mpack_start_array(&writer, 2);
+    mpack_write_float(&writer, scale->minimum);
+    mpack_write_float(&writer, scale->resolution);
+    mpack_finish_array(&writer);
+  }
+
+  // Write key and type headers
+  mpack_write_u16(&writer, (uint16_t)point->key);
+  if (isScaled) {
+    // Round to the nearest step, clamped to the range (NaN goes to the minimum)
+    float steps = (point->value.v_float32 - scale->minimum) / scale->resolution + 0.5f;
+    uint32_t n = 0;
+    if (steps >= (float)scale->steps) {
+      n = scale->steps;
+    } else if (steps >= 1.0f) {
+      n = (uint32_t)steps;
+    }
+    mpack_write_u8(&writer, TELEMETRYJET_SCALED_VALUE_TYPE);
+    mpack_write_u32(&writer, n);
+  } else if (point->arrayLength > 0) {
+    mpack_write_u8(&writer, (uint8_t)point->type | TELEMETRYJET_ARRAY_TYPE_FLAG);
+  } else {
+    mpack_write_u8(&writer, (uint8_t)point->type);
+  }
+
+  // Write data
+  if (isScaled) {
+    // Already written with its header
+  } else if (point->arrayLength > 0) {
+    uint8_t size = valueSize(point->type);
+    mpack_start_array(&writer, point->arrayLength);
+    for (uint8_t i = 0; i < point->arrayLength; i++) {
+      DataPointValue element;
+      memcpy(&element, (uint8_t*)point->arrayValues + i * size, size);
+      writeValue(&writer, point->type, element);
+    }
+    mpack_finish_array(&writer);
+  } else {
+    writeValue(&writer, point->type, point->value);
+  }
+
+  size_t length = mpack_writer_buffer_used(&writer);
+  if (mpack_writer_destroy(&writer) != mpack_ok) {
+    return 0;
+  }
+  return length;
+}
+
+// Count a record written with encodeRecord into an outgoing frame
+static void recordSent(DataPoint* point) {
+  DataPointScale* scale = point->scale;
+  if (scale != NULL && scale->steps > 0 && point->type == DataPointType::FLOAT32 && point->arrayLength == 0) {
+    // Repeat the scale record every TELEMETRYJET_SCALE_INTERVAL values, in case it was lost
+    uint8_t countdown = (scale->announceCountdown == 0) ? TELEMETRYJET_SCALE_INTERVAL : scale->announceCountdown;
+    scale->announceCountdown = countdown - 1;
+  }
+}
+
+// Encode a control record into a buffer
+// Returns the encoded length, or 0 if the record doesn't fit.
+static size_t encodeControlRecord(uint16_t key, ControlType type, uint32_t value, uint8_t* buffer, size_t bufferSize) {
+  mpack_writer_t writer;
+  mpack_writer_init(&writer, (char*)buffer, bufferSize);
+  mpack_write_u16(&writer, key);
+  mpack_write_u8(&writer, (uint8_t)type);
+  mpack_write_u32(&writer, value);
+
+  size_t length = mpack_writer_buffer_used(&writer);
+  if (mpack_writer_destroy(&writer) != mpack_ok) {
+    return 0;
+  }
+  return length;
+}
+
+// Append a control record to the outgoing frame
+void TelemetryJet::writeControlRecord(uint16_t key, ControlType type, uint32_t value) {
+  size_t length = encodeControlRecord(key, type, value, tempBuffer + txPayloadLength, maxPayloadSize - txPayloadLength);
+  if (length == 0 && txPayloadLength > 0) {
+    flushFrame();
+    length = encodeControlRecord(key, type, value, tempBuffer, maxPayloadSize);
+  }
+  if (canBatch != NULL) {
+    // CAN transports get control records in the batch
+    memcpy(canBatch + canBatchLength, tempBuffer + txPayloadLength, length);
+    canBatchLength += length;
+  }
+  txPayloadLength += length;
+}
+
+// Append a record to the outgoing frame
+// If the frame is full, it is sent and the record starts a new frame.
+// Returns false if the record has to wait for this device's next bus slot; the caller keeps the value pending.
+bool TelemetryJet::writeRecord(DataPoint* point) {
+  size_t length = encodeRecord(point, tempBuffer + txPayloadLength, maxPayloadSize - txPayloadLength);
+  if (length == 0 && txPayloadLength > 0) {
+    flushFrame();
+    length = encodeRecord(point, tempBuffer, maxPayloadSize);
+  }
+  if (length == 0) {
+    // Can't fit even in an empty frame
+    linkStatistics.txDroppedRecords++;
+    return true;
+  }
+#if TELEMETRYJET_RX
+  if (txPayloadLength + length > getBusTurnPayloadSize()) {
+    // The frame would run past the end of this device's bus slot; the rest of the slot is given up
+    busTurnBytes = 0;
+    return false;
+  }
+#endif
+  if (canBatch != NULL) {
+    writeCanRecord(point, tempBuffer + txPayloadLength, length);
+  }
+  txPayloadLength += length;
+  recordSent(point);
+  return true;
+}
+
+void TelemetryJet::beginTransaction() {
+  if (!isInTransaction) {
+    isInTransaction = true;
+    transactionTimestamp = millis();
+  }
+}
+
+bool TelemetryJet::commit() {
+  if (!isInTransaction) {
+    return true;
+  }
+  isInTransaction = false;
+  commitCount++;
+  // Total length of this commit's records
+  uint16_t size = 0;
+  for (uint16_t i = 0; i < numTransactionValues; i++) {
+    TransactionValue* entry = &transactionValues[i];
+    if (entry->isCommitted) {
+      continue;
+    }
+    entry->isCommitted = true;
+    entry->commit = commitCount;
+    DataPoint* point = dimensions[entry->id];
+    bool isStored = storeTransactionValue(point, entry);
+    free(entry->arrayValues);
+    entry->arrayValues = NULL;
+    if (!isStored) {
+      continue;
+    }
+    point->hasNewReceivedValue = false;
+    point->hasNewTransmitValue = true;
+    if (point->isUrgent) {
+      hasUrgentValue = true;
+    }
+    if (!point->isReliable) {
+      size += measureRecord(point);
+    }
+  }
+  return size <= maxPayloadSize;
+}
+
+// Hold a value set inside a transaction until commit(), replacing one held earlier for the same dimension
+// Array values are copied. If there is no memory to hold the value, it is dropped.
+void TelemetryJet::holdTransactionValue(uint16_t id, DataPointType type, const DataPointValue& value, const void* arrayValues, uint8_t arrayLength) {
+  void* arrayCopy = NULL;
+  if (arrayLength > 0) {
+    uint16_t arraySize = arrayLength * valueSize(type);
+    arrayCopy = malloc(arraySize);
+    if (arrayCopy == NULL) {
+      return;
+    }
+    memcpy(arrayCopy, arrayValues, arraySize);
+  }
+  TransactionValue* entry = NULL;
+  for (uint16_t i = 0; i < numTransactionValues; i++) {
+    if (transactionValues[i].id == id && !transactionValues[i].isCommitted) {
+      entry = &transactionValues[i];
+      free(entry->arrayValues);
+      break;
+    }
+  }
+  if (entry == NULL) {
+    if (numTransactionValues == transactionCapacity) {
+      TransactionValue* newValues = (TransactionValue*) realloc(transactionValues, sizeof(TransactionValue) * (transactionCapacity + 4));
+      if (newValues == NULL) {
+        free(arrayCopy);
+        return;
+      }
+      transactionValues = newValues;
+      transactionCapacity += 4;
+    }
+    entry = &transactionValues[numTransactionValues++];
+    entry->id = id;
+    entry->isCommitted = false;
+  }
+  entry->type = type;
+  entry->value = value;
+  entry->arrayLength = arrayLength;
+  entry->arrayValues = arrayCopy;
+}
+
+// Store a committed value in its data point, with the transaction's timestamp
+// Returns false if the dimension was bound or given a fixed type it doesn't match since the value was set.
+bool TelemetryJet::storeTransactionValue(DataPoint* point, TransactionValue* entry) {
+  DataPointType type = entry->type;
+  DataPointValue value = entry->value;
+  if (entry->arrayLength > 0) {
+    uint16_t arraySize = entry->arrayLength * valueSize(type);
+    bool isFixedMismatch = point->hasFixedType && point->type != type;
+    if (point->binding != DataPointBinding::NONE || isFixedMismatch || !reserveArray(point, arraySize)) {
+      return false;
+    }
+  } else if (!matchFixedType(point, type, value)) {
+    return false;
+  }
+  beginWrite(point);
+  point->type = type;
+  if (entry->arrayLength > 0) {
+    memcpy(point->arrayValues, entry->arrayValues, entry->arrayLength * valueSize(type));
+  } else {
+    point->value = value;
+  }
+  point->arrayLength = entry->arrayLength;
+  point->lastTimestamp = transactionTimestamp;
+  point->hasValue = true;
+  endWrite(point);
+  return true;
+}
+
+// Length of a point's record, measured in the (idle) stuffing buffer
+// A record that can't fit in a frame counts as longer than the frame.
+uint16_t TelemetryJet::measureRecord(DataPoint* point) {
+  size_t length = (txBuffer != NULL) ? encodeRecord(point, txBuffer, maxPayloadSize) : 0;
+  return (length > 0) ? length : maxPayloadSize + 1;
+}
+
+// Number of committed values at the start of the transaction list; values not committed yet come after them
+uint16_t TelemetryJet::countCommittedValues() {
+  uint16_t count = 0;
+  while (count < numTransactionValues && transactionValues[count].isCommitted) {
+    count++;
+  }
+  return count;
+}
+
+// Drop the first 'count' values of the transaction list
+void TelemetryJet::removeTransactionValues(uint16_t count) {
+  if (count == 0) {
+    return;
+  }
+  numTransactionValues -= count;
+  memmove(transactionValues, transactionValues + count, sizeof(TransactionValue) * numTransactionValues);
+}
+
+// Whether a dimension has one of the first 'count' values of the transaction list
+bool TelemetryJet::isTransactionValue(uint16_t id, uint16_t count) {
+  for (uint16_t i = 0; i < count; i++) {
+    if (transactionValues[i].id == id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Write committed transaction values, one commit at a time
+// A commit that doesn't fit in the rest of the current frame starts a new frame.
+// Returns the number of values written; the caller removes them from the list with removeTransactionValues().
+// A commit that doesn't fit in the rest of this device's bus slot waits for the next one, with the commits after it.
+uint16_t TelemetryJet::writeTransaction() {
+  uint16_t numCommitted = countCommittedValues();
+  uint16_t start = 0;
+  while (start < numCommitted) {
+    uint16_t end = start;
+    uint16_t size = 0;
+    while (end < numCommitted && transactionValues[end].commit == transactionValues[start].commit) {
+      DataPoint* point = dimensions[transactionValues[end].id];
+      if (!point->isReliable && point->hasNewTransmitValue) {
+        size += measureRecord(point);
+      }
+      end++;
+    }
+    if (txPayloadLength + size > maxPayloadSize) {
+      flushFrame();
+    }
+#if TELEMETRYJET_RX
+    // Commits larger than a frame are split over frames anyway
+    if (size <= maxPayloadSize && txPayloadLength + size > getBusTurnPayloadSize()) {
+      busTurnBytes = 0;
+      return start;
+    }
+#endif
+    for (uint16_t i = start; i < end; i++) {
+      uint16_t id = transactionValues[i].id;
+      DataPoint* point = dimensions[id];
+      updateHasValue(id);
+      // Reliable values go through the reliable window instead
+      if (!point->isReliable && point->hasValue && point->hasNewTransmitValue && isSubscribed(id)) {
+        point->hasNewTransmitValue = false;
+        if (!writeRecord(point)) {
+          point->hasNewTransmitValue = true;
+        }
+      }
+    }
+    start = end;
+  }
+  return numCommitted;
+}
+
+Waveform TelemetryJet::createWaveform(uint16_t key, uint32_t sampleRate, uint16_t blockSize) {
+  // Waveform IDs are 8 bits wide
+  if (numWaveforms == 0xFF) {
+    return Waveform(0, NULL);
+  }
+  if (blockSize == 0) {
+    blockSize = 1;
+  }
+  WaveformChannel* channel = (WaveformChannel*) malloc(sizeof(WaveformChannel));
+  int16_t* samples = (int16_t*) malloc(sizeof(int16_t) * blockSize * 2);
+  WaveformChannel** newWaveforms = (WaveformChannel**) malloc(sizeof(WaveformChannel*) * (numWaveforms + 1));
+  if (channel == NULL || samples == NULL || newWaveforms == NULL) {
+    free(channel);
+    free(samples);
+    free(newWaveforms);
+    return Waveform(0, NULL);
+  }
+  channel->key = key;
+  channel->blockSize = blockSize;
+  channel->sampleRate = sampleRate;
+  channel->samples = samples;
+  channel->fillIndex = 0;
+  channel->fillBlock = 0;
+  channel->isBlockReady[0] = false;
+  channel->isBlockReady[1] = false;
+  channel->nextSequence = 0;
+  channel->droppedBlocks = 0;
+  channel->droppedBlocksCounted = 0;
+  channel->sendOffset = 0;
+
+  // Resize waveform array by one entry
+  for (uint8_t i = 0; i < numWaveforms; i++) {
+    newWaveforms[i] = waveforms[i];
+  }
+  free(waveforms);
+  waveforms = newWaveforms;
+  waveforms[numWaveforms] = channel;
+  return Waveform(numWaveforms++, this);
+}
+
+// Encode part of a waveform block as a single record
+// Writes as many samples as fit in the buffer, and returns the number of samples written (0 if none fit).
+static uint16_t encodeWaveformChunk(WaveformChannel* channel, uint8_t block, uint16_t offset, uint8_t* buffer, size_t bufferSize, size_t* length) {
+  // Worst case size of everything but the samples: key, type, array, sequence, rate, start time, offset, bin header
+  const size_t headerSize = 3 + 1 + 1 + 3 + 5 + 5 + 3 + 3;
+  if (bufferSize <= headerSize + 1) {
+    return 0;
+  }
+  uint16_t count = channel->blockSize - offset;
+  if (count > (bufferSize - headerSize) / 2) {
+    count = (bufferSize - headerSize) / 2;
+  }
+
+  mpack_writer_t writer;
+  mpack_writer_init(&writer, (char*)buffer, bufferSize);
+  mpack_write_u16(&writer, channel->key);
+  mpack_write_u8(&writer, TELEMETRYJET_BLOCK_TYPE);
+  mpack_start_array(&writer, 5);
+  mpack_write_u16(&writer, channel->blockSequence[block]);
+  mpack_write_u32(&writer, channel->sampleRate);
+  mpack_write_u32(&writer, channel->blockStart[block]);
+  mpack_write_u16(&writer, offset);
+  mpack_start_bin(&writer, count * 2);
+  const int16_t* samples = channel->samples + block * channel->blockSize + offset;
+  for (uint16_t i = 0; i < count; i++) {
+    uint8_t bytes[2] = { (uint8_t)(samples[i] & 0xFF), (uint8_t)((uint16_t)samples[i] >> 8) };
+    mpack_write_bytes(&writer, (const char*)bytes, 2);
+  }
+  mpack_finish_bin(&writer);
+  mpack_finish_array(&writer);
+
+  *length = mpack_writer_buffer_used(&writer);
+  if (mpack_writer_destroy(&writer) != mpack_ok) {
+    return 0;
+  }
+  return count;
+}
+
+// Send full waveform blocks, one frame per chunk, within the waveform link budget
+void TelemetryJet::writeWaveforms() {
+  if (numWaveforms == 0) {
+    return;
+  }
+  if (waveformBudget > 0) {
+    // Earn credit for the time since the last call, keeping at most 1/8 second (or one frame) of burst
+    uint32_t now = millis();
+    uint32_t limit = waveformBudget / 8;
+    if (limit < maxFrameSize) {
+      limit = maxFrameSize;
+    }
+    uint32_t earned = (now - waveformCreditTime) * waveformBudget / 1000;
+    waveformCredit = (earned >= limit) ? (int32_t)limit : waveformCredit + (int32_t)earned;
+    if (waveformCredit > (int32_t)limit) {
+      waveformCredit = limit;
+    }
+    waveformCreditTime = now;
+  }
+
+  for (uint8_t i = 0; i < numWaveforms; i++) {
+    WaveformChannel* channel = waveforms[i];
+    uint8_t dropped = channel->droppedBlocks;
+    linkStatistics.txWaveformDroppedBlocks += (uint8_t)(dropped - channel->droppedBlocksCounted);
+    channel->droppedBlocksCounted = dropped;
+
+    for (uint8_t block = 0; block < 2; block++) {
+      if (!channel->isBlockReady[block]) {
+        continue;
+      }
+      TELEMETRYJET_MEMORY_BARRIER();
+      // Waveform chunks go in frames of their own, after any pending records
+      flushFrame();
+      while (channel->sendOffset < channel->blockSize) {
+        if (waveformBudget > 0 && waveformCredit <= 0) {
+          return;
+        }
+        size_t length = 0;
+        uint16_t payloadSize = maxPayloadSize;
+#if TELEMETRYJET_RX
+        // On a bus, the chunk has to fit in the rest of this device's slot
+        payloadSize = getBusTurnPayloadSize();
+#endif
+        uint16_t count = encodeWaveformChunk(channel, block, channel->sendOffset, tempBuffer, payloadSize, &length);
+        if (count == 0 && payloadSize < maxPayloadSize) {
+          // The rest of the block goes out in the next bus slot
+          return;
+        }
+        if (count == 0) {
+          // Frames are too small to hold any samples
+          channel->sendOffset = channel->blockSize;
+          break;
+        }
+        uint32_t sentBytes = linkStatistics.txBytes;
+        sendPayload(tempBuffer, length);
+        sentBytes = linkStatistics.txBytes - sentBytes;
+        linkStatistics.txWaveformBytes += sentBytes;
+        waveformCredit -= sentBytes;
+        channel->sendOffset += count;
+      }
+      linkStatistics.txWaveformBlocks++;
+      channel->sendOffset = 0;
+      TELEMETRYJET_MEMORY_BARRIER();
+      channel->isBlockReady[block] = false;
+    }
+  }
+}
+
+// Producer side of the waveform double buffer, may run in an interrupt handler
+bool Waveform::push(int16_t sample) {
+  if (_parent == NULL) {
+    return false;
+  }
+  WaveformChannel* channel = _parent->waveforms[_id];
+  uint8_t block = channel->fillBlock;
+  uint16_t index = channel->fillIndex;
+  if (index == 0) {
+    channel->blockStart[block] = micros();
+  }
+  channel->samples[block * channel->blockSize + index] = sample;
+  index++;
+  if (index < channel->blockSize) {
+    channel->fillIndex = index;
+    return true;
+  }
+
+  // Block complete: hand it over, and fill the other block, unless that one is still being sent
+  channel->fillIndex = 0;
+  channel->blockSequence[block] = channel->nextSequence++;
+  if (channel->isBlockReady[block ^ 1]) {
+    channel->droppedBlocks++;
+    return false;
+  }
+  TELEMETRYJET_MEMORY_BARRIER();
+  channel->isBlockReady[block] = true;
+  channel->fillBlock = block ^ 1;
+  return true;
+}
+
+bool Waveform::isValid() {
+  return _parent != NULL;
+}
+
+uint16_t Waveform::getBlockSize() {
+  if (_parent == NULL) {
+    return 0;
+  }
+  return _parent->waveforms[_id]->blockSize;
+}
+
+uint32_t Waveform::getSampleRate() {
+  if (_parent == NULL) {
+    return 0;
+  }
+  return _parent->waveforms[_id]->sampleRate;
+}
+
+// Frame and send all records written since the last flush
+void TelemetryJet::flushFrame() {
+  if (txPayloadLength == 0) {
+    return;
+  }
+  writeFrame(tempBuffer, txPayloadLength);
+  // The frame's small values already went out as CAN frames of their own; its other records follow as one batch
+  if (canBatchLength > 0) {
+    writeCanBatches(canBatch, canBatchLength);
+    canBatchLength = 0;
+  }
+  txPayloadLength = 0;
+}
+
+// Send a MessagePack payload of at most maxPayloadSize bytes on every transport
+// The payload has to arrive whole, like a reliable frame or a waveform chunk, so CAN transports get it as one batch.
+void TelemetryJet::sendPayload(const uint8_t* payload, uint16_t payloadLength) {
+  writeFrame(payload, payloadLength);
+  writeCanBatches(payload, payloadLength);
+}
+
+// Frame a MessagePack payload of at most maxPayloadSize bytes, and write it to the main and binary transports
+void TelemetryJet::writeFrame(const uint8_t* payload, uint16_t payloadLength) {
+  bool hasStream = transport != NULL;
+  for (uint8_t i = 0; i < numTransports && !hasStream; i++) {
+    hasStream = transports[i]->mode == TransportMode::BINARY;
+  }
+  // Without any stream, there is nothing to frame; the payload bytes are counted instead
+  uint16_t frameLength = payloadLength;
+
+  // Write the whole frame in one call, so the transport can copy it in bulk
+  // Time spent here is the write backpressure: a full transport buffer makes write() block.
+  // Additional binary transports get the same bytes, but for the bus address byte; the frame is only counted once
+  // in the link statistics.
+  uint32_t writeStart = micros();
+  if (hasStream) {
+    txSequence = (txSequence >= TELEMETRYJET_MAX_SEQUENCE) ? 1 : txSequence + 1;
+    frameLength = encodeFrame(payload, payloadLength, txSequence, true);
+    writeMainTransport(txBuffer, frameLength);
+    uint16_t transportFrameLength = frameLength;
+#if TELEMETRYJET_RX
+    // Additional transports aren't on the bus, so they get the frame again without the address byte
+    bool isBusFrame = busRole != BusRole::NONE;
+#endif
+    for (uint8_t i = 0; i < numTransports; i++) {
+      if (transports[i]->mode == TransportMode::BINARY) {
+#if TELEMETRYJET_RX
+        if (isBusFrame) {
+          transportFrameLength = encodeFrame(payload, payloadLength, txSequence, false);
+          isBusFrame = false;
+        }
+#endif
+        transports[i]->stream->write(txBuffer, transportFrameLength);
+      }
+    }
+  }
+  tickWriteMicros += micros() - writeStart;
+  tickBytes += frameLength;
+  linkStatistics.txFrames++;
+  linkStatistics.txBytes += frameLength;
+}
+
+// Frame a MessagePack payload of at most maxPayloadSize bytes into txBuffer, and return the frame length
+// Frames sent to a single transport go unnumbered (sequence 0), so the other transports don't count them as lost.
+// Frames for the main transport (isOnBus) carry the address byte in bus mode; on a bus master, busDestination
+// addresses the frame to one node.
+uint16_t TelemetryJet::encodeFrame(const uint8_t* payload, uint16_t payloadLength, uint8_t sequence, bool isOnBus, uint8_t busDestination) {
+  // Use COBS (Consistent Overhead Byte Stuffing)
+  // https://en.wikipedia.org/wiki/Consistent_Overhead_Byte_Stuffing
+  // to replace all 0x0 bytes in the packet.
+  // This way, we can use 0x0 as a packet frame marker.
+  // The stuffed data starts after the checksum and checksum correction byte, and the address on a bus.
+  // The address byte is never 0, so it doesn't need stuffing.
+#if TELEMETRYJET_RX
+  uint8_t headerLength = 2;
+  if (isOnBus && busRole == BusRole::NODE) {
+    txBuffer[headerLength++] = busAddress;
+  } else if (isOnBus && busRole == BusRole::MASTER) {
+    txBuffer[headerLength++] = TELEMETRYJET_BUS_MASTER_FLAG | busDestination;
+  }
+#else
+  // There is no bus without the receive path
+  (void)isOnBus;
+  (void)busDestination;
+  const uint8_t headerLength = 2;
+#endif
+  size_t packetLength = StuffData(payload, payloadLength, txBuffer + headerLength) + headerLength - 2;
+
+  // Compute checksum and add to front of the packet
+  // We never want the checksum to == 0,
+  // because that would complicate the COBS & packet frame marker logic.
+  // If the checksum is going to be 0, add a single bit so that it won't be.
+  uint8_t checksum = 0;
+  for (uint16_t bufferIdx = 0; bufferIdx < packetLength; bufferIdx++) {
+    checksum += txBuffer[bufferIdx + 2];
+  }
+
+  // The flag byte carries the checksum correction in the low 2 bits,
+  // and a rolling sequence number (1-63) in the upper 6 bits.
+  // Sequence number 0 is never sent; it marks frames from senders without sequence numbers.
+  uint8_t flagByte = (sequence << 2) | 0x01;
+  checksum = 0xFF - (checksum + flagByte);
+  if (checksum == 0x0) {
+    // Increment byte in the front of the packet to correct the checksum
+    // If the checksum was previously 0x0 (0), it will now be 0xFF (255).
+    flagByte += 1;
+    checksum = 0xFF;
+  }
+  txBuffer[0] = checksum;
+  txBuffer[1] = flagByte;
+  return packetLength + 2;
+}
+
+// Write a frame to the main transport, driving the bus direction pin around it
+void TelemetryJet::writeMainTransport(const uint8_t* frame, uint16_t length) {
+  if (transport == NULL) {
+    return;
+  }
+#if TELEMETRYJET_RX
+  if (busDirectionPin >= 0) {
+    digitalWrite(busDirectionPin, HIGH);
+  }
+#endif
+  transport->write(frame, length);
+#if TELEMETRYJET_RX
+  if (busTurnBytes != 0xFFFF) {
+    busTurnBytes = (length < busTurnBytes) ? busTurnBytes - length : 0;
+  }
+  if (busRole != BusRole::NONE) {
+    // Keep track of when the bytes written so far will have left, for the next slot's budget
+    uint32_t now = micros();
+    if ((int32_t)(busTxEnd - now) < 0) {
+      busTxEnd = now;
+    }
+    busTxEnd += (uint32_t)length * 100000UL / (busBaudRate / 100);
+  }
+  if (busDirectionPin >= 0) {
+    // Release the bus only once the last byte is out
+    transport->flush();
+    digitalWrite(busDirectionPin, LOW);
+  }
+#endif
+}
+
+// Send a batch as a single frame, or a first frame and consecutive frames, see receiveCanSegment
+static void writeCanBatch(CanDriver* driver, uint32_t id, const uint8_t* batch, uint16_t length) {
+  uint8_t data[8];
+  if (length <= 7) {
+    data[0] = length;
+    memcpy(data + 1, batch, length);
+    driver->write(id, data, length + 1);
+    return;
+  }
+  data[0] = 0x10 | (length >> 8);
+  data[1] = length & 0xFF;
+  memcpy(data + 2, batch, 6);
+  if (!driver->write(id, data, 8)) {
+    return;
+  }
+  uint8_t sequence = 1;
+  for (uint16_t offset = 6; offset < length; offset += 7) {
+    uint8_t count = (length - offset > 7) ? 7 : length - offset;
+    data[0] = 0x20 | sequence;
+    memcpy(data + 1, batch + offset, count);
+    if (!driver->write(id, data, count + 1)) {
+      // The receiver drops a batch with a missing segment, so the rest isn't worth sending
+      return;
+    }
+    sequence = (sequence + 1) & 0x0F;
+  }
+}
+
+// Send a batch to every CAN transport
+void TelemetryJet::writeCanBatches(const uint8_t* batch, uint16_t length) {
+  for (uint8_t i = 0; i < numTransports; i++) {
+    if (transports[i]->mode == TransportMode::CAN) {
+      writeCanBatch(transports[i]->can, transports[i]->canTxBatchId, batch, length);
+    }
+  }
+}
+
+// Send a record just added to the outgoing frame to every CAN transport
+// A value of up to 4 bytes goes straight from its data point into a CAN frame of its own: its type, then its raw
+// little-endian bytes. Any other record is copied, as encoded, to the batch sent with the frame.
+void TelemetryJet::writeCanRecord(DataPoint* point, const uint8_t* record, uint16_t length) {
+  uint8_t size = valueSize(point->type);
+  if (point->arrayLength > 0 || size == 0 || size > 4) {
+    memcpy(canBatch + canBatchLength, record, length);
+    canBatchLength += length;
+    return;
+  }
+  uint32_t bits;
+  if (point->type == DataPointType::BOOLEAN) {
+    bits = point->value.v_bool ? 1 : 0;
+  } else if (size == 1) {
+    bits = point->value.v_uint8;
+  } else if (size == 2) {
+    bits = point->value.v_uint16;
+  } else {
+    bits = point->value.v_uint32;
+  }
+  uint8_t data[5];
+  data[0] = (uint8_t)point->type;
+  for (uint8_t i = 0; i < size; i++) {
+    data[1 + i] = bits >> (8 * i);
+  }
+  for (uint8_t i = 0; i < numTransports; i++) {
+    if (transports[i]->mode == TransportMode::CAN) {
+      transports[i]->can->write(transports[i]->canBaseId + point->key, data, size + 1);
+    }
+  }
+}
+
+#if TELEMETRYJET_RX
+// Pack pending reliable values into new frames in the retransmit window, and send them
+// Values that don't fit while the window is full stay pending for a later tick.
+void TelemetryJet::writeReliableFrames(bool urgentOnly) {
+  if (reliableBuffer == NULL) {
+    return;
+  }
+  uint16_t i = 0;
+  while (i < numDimensions && (uint16_t)(reliableTxNext - reliableTxBase) < TELEMETRYJET_RELIABLE_WINDOW) {
+    uint8_t slot = reliableTxNext % TELEMETRYJET_RELIABLE_WINDOW;
+    uint8_t* payload = reliableBuffer + (size_t)slot * maxPayloadSize;
+    // On a bus, the frame has to fit in the rest of this device's slot
+    uint16_t payloadSize = getBusTurnPayloadSize();
+
+    // Every reliable frame starts with its sequence number
+    uint16_t length = encodeControlRecord(reliableTxNext, ControlType::RELIABLE, reliableTxSync ? 1 : 0, payload, payloadSize);
+    if (length == 0) {
+      busTurnBytes = 0;
+      return;
+    }
+    uint16_t headerLength = length;
+    for (; i < numDimensions; i++) {
+      DataPoint* point = dimensions[i];
+      if (!point->isReliable || !point->hasValue || !point->hasNewTransmitValue || (urgentOnly && !point->isUrgent) || !isSubscribed(i)) {
+        continue;
+      }
+      size_t recordLength = encodeRecord(point, payload + length, payloadSize - length);
+      if (recordLength == 0) {
+        if (length == headerLength && payloadSize < maxPayloadSize) {
+          // Held for the next bus slot
+          busTurnBytes = 0;
+          return;
+        }
+        if (length == headerLength) {
+          // Can't fit even in an empty frame
+          point->hasNewTransmitValue = false;
+          linkStatistics.txDroppedRecords++;
+          continue;
+        }
+        // Frame is full; continue with this record in the next frame
+        break;
+      }
+      point->hasNewTransmitValue = false;
+      length += recordLength;
+      recordSent(point);
+    }
+    if (length == headerLength) {
+      return;
+    }
+
+    reliableSlotLength[slot] = length;
+    reliableSlotTimestamp[slot] = millis();
+    reliableTxNext++;
+    sendPayload(payload, length);
+  }
+}
+
+// Resend every unacknowledged reliable frame, in order, once the oldest has timed out
+void TelemetryJet::retransmitReliableFrames() {
+  if (reliableTxNext == reliableTxBase) {
+    return;
+  }
+  uint8_t oldestSlot = reliableTxBase % TELEMETRYJET_RELIABLE_WINDOW;
+  if (millis() - reliableSlotTimestamp[oldestSlot] < reliableTimeout) {
+    return;
+  }
+  for (uint16_t sequence = reliableTxBase; sequence != reliableTxNext; sequence++) {
+    uint8_t slot = sequence % TELEMETRYJET_RELIABLE_WINDOW;
+    if (reliableSlotLength[slot] > getBusTurnPayloadSize()) {
+      // The rest go out in the next bus slot
+      busTurnBytes = 0;
+      return;
+    }
+    reliableSlotTimestamp[slot] = millis();
+    sendPayload(reliableBuffer + (size_t)slot * maxPayloadSize, reliableSlotLength[slot]);
+    linkStatistics.txRetransmittedFrames++;
+  }
+}
+
+// Update the loss and reordering counters of a sender from the sequence number of its frame
+// The counters are kept for the sender, and summed over every sender in the link statistics.
+void TelemetryJet::updateRxSequence(ReceiveState* state, uint8_t sequence) {
+  if (sequence == 0) {
+    // Sender doesn't number its frames
+    return;
+  }
+  ReceiveStatistics* statistics = &state->statistics;
+  if (state->rxSequence == 0) {
+    state->rxSequence = sequence;
+    updateLossRate(state, false);
+    return;
+  }
+
+  // Distance from the last in-order frame, counted around the 1-63 cycle
+  uint8_t distance = (sequence + TELEMETRYJET_MAX_SEQUENCE - state->rxSequence) % TELEMETRYJET_MAX_SEQUENCE;
+  if (distance == 0) {
+    statistics->rxDuplicateFrames++;
+    linkStatistics.rxDuplicateFrames++;
+  } else if (distance <= TELEMETRYJET_MAX_SEQUENCE / 2) {
+    // Frames between the last one and this one never arrived
+    for (uint8_t i = 1; i < distance; i++) {
+      statistics->rxLostFrames++;
+      linkStatistics.rxLostFrames++;
+      updateLossRate(state, true);
+    }
+    updateLossRate(state, false);
+    state->rxSequence = sequence;
+  } else {
+    // Older than the last frame: it was counted as lost when the gap was seen
+    statistics->rxReorderedFrames++;
+    linkStatistics.rxReorderedFrames++;
+    if (statistics->rxLostFrames > 0) {
+      statistics->rxLostFrames--;
+      linkStatistics.rxLostFrames--;
+    }
+  }
+}
+
+// Exponentially weighted moving average of the frame loss rate, weight 1/16 per frame
+// The link statistics average the frames of every sender together.
+void TelemetryJet::updateLossRate(ReceiveState* state, bool lost) {
+  if (lost) {
+    state->statistics.rxLossRate += (1.0 - state->statistics.rxLossRate) / 16.0;
+    linkStatistics.rxLossRate += (1.0 - linkStatistics.rxLossRate) / 16.0;
+  } else {
+    state->statistics.rxLossRate -= state->statistics.rxLossRate / 16.0;
+    linkStatistics.rxLossRate -= linkStatistics.rxLossRate / 16.0;
+  }
+}
+
+// Acknowledge received reliable frames right away, so their senders can free their windows
+// Each sender numbers its reliable frames separately, so an ACK only goes back on the transport its frames came from.
+// On a bus master, the ACK is addressed to the node that sent the frames.
+void TelemetryJet::writeAcks() {
+  if (rxState.hasReliableAck) {
+    sendAck(&rxState, NULL, TELEMETRYJET_BUS_BROADCAST);
+  }
+  for (uint8_t i = 0; busRole == BusRole::MASTER && i < busNumNodes; i++) {
+    if (busNodeStates[i].hasReliableAck) {
+      sendAck(&busNodeStates[i], NULL, i + 1);
+    }
+  }
+  for (uint8_t i = 0; i < numTransports; i++) {
+    if (transports[i]->mode != TransportMode::TEXT && transports[i]->rxState.hasReliableAck) {
+      sendAck(&transports[i]->rxState, transports[i], TELEMETRYJET_BUS_BROADCAST);
+    }
+  }
+}
+
+// Send an ACK in a frame of its own, to the main transport (channel NULL) or to one additional transport
+void TelemetryJet::sendAck(ReceiveState* state, TransportChannel* channel, uint8_t busDestination) {
+  uint8_t payload[16];
+  uint16_t length = encodeControlRecord(state->reliableRxExpected - 1, ControlType::ACK, 0, payload, sizeof(payload));
+  if (channel == NULL && length > getBusTurnPayloadSize()) {
+    // Sent in the next bus slot
+    busTurnBytes = 0;
+    return;
+  }
+  state->hasReliableAck = false;
+  if (channel != NULL && channel->mode == TransportMode::CAN) {
+    writeCanBatch(channel->can, channel->canTxBatchId, payload, length);
+    return;
+  }
+  // Frames are unnumbered, and only those on the main transport go on the bus
+  uint16_t frameLength = encodeFrame(payload, length, 0, channel == NULL, busDestination);
+  if (channel == NULL) {
+    writeMainTransport(txBuffer, frameLength);
+  } else {
+    channel->stream->write(txBuffer, frameLength);
+  }
+  linkStatistics.txFrames++;
+  linkStatistics.txBytes += frameLength;
+}
+
+#endif
+
+// Check whether a dimension should skip this tick at the current decimation level
+// Each level above the dimension's priority halves its rate.
+bool TelemetryJet::isDecimated(DataPoint* point) {
+  if (decimationLevel <= point->priority) {
+    return false;
+  }
+  uint16_t divisor = 1 << (decimationLevel - point->priority);
+  return (tickCount % divisor) != 0;
+}
+
+// Update the throughput estimate and decimation level at the end of a transmit tick
+void TelemetryJet::updateAdaptiveRate(uint32_t elapsed) {
+  // Moving average of bytes per second, weight 1/4 per tick
+  if (elapsed > 0) {
+    uint32_t rate = (tickBytes * 1000) / elapsed;
+    effectiveRate = effectiveRate - (effectiveRate / 4) + (rate / 4);
+  }
+
+  bool congested = (tickWriteMicros > transmitRate * 250)
+    || (linkStatistics.rxLossRate > TELEMETRYJET_ADAPTIVE_LOSS_THRESHOLD);
+  tickBytes = 0;
+  tickWriteMicros = 0;
+
+  if (!isAdaptiveRate) {
+    return;
+  }
+  if (congested) {
+    // Back off quickly: one level per congested tick
+    uncongestedTicks = 0;
+    if (decimationLevel < TELEMETRYJET_MAX_DECIMATION_LEVEL) {
+      decimationLevel++;
+    }
+  } else if (decimationLevel > 0) {
+    // Recover slowly, one level after several clean ticks
+    uncongestedTicks++;
+    if (uncongestedTicks >= TELEMETRYJET_ADAPTIVE_RECOVERY_TICKS) {
+      uncongestedTicks = 0;
+      decimationLevel--;
+    }
+  }
+}
+
+void TelemetryJet::setSubscribed(uint16_t id, bool subscribed) {
+  if (subscribed) {
+    subscriptions[id / 8] |= (1 << (id % 8));
+  } else {
+    subscriptions[id / 8] &= ~(1 << (id % 8));
   }
-
-  return dst - start;
 }
 
-void TelemetryJet::update() {
-  if (!isInitialized) {
-    if (hasBinaryWarningMessage && !isTextMode) {
-      transport->println(F("Started streaming data in Binary mode. This data is not human-readable."));
-      transport->println(F("For usage information, please see https://docs.telemetryjet.com/."));
-    }
-    isInitialized = true; 
+void TelemetryJet::resetLinkStatistics() {
+  linkStatistics = LinkStatistics();
+#if TELEMETRYJET_RX
+  rxState.rxSequence = 0;
+  rxState.statistics = ReceiveStatistics();
+  for (uint8_t i = 0; i < numTransports; i++) {
+    transports[i]->rxState.rxSequence = 0;
+    transports[i]->rxState.statistics = ReceiveStatistics();
   }
+  for (uint8_t i = 0; busRole == BusRole::MASTER && i < busNumNodes; i++) {
+    busNodeStates[i].rxSequence = 0;
+    busNodeStates[i].statistics = ReceiveStatistics();
+  }
+#endif
+}
 
-  if (isTextMode) {
-    // Text mode
-    // Don't read inputs; just log as text output to the serial stream
-    // Useful for debugging purposes
-    while (transport->available() > 0) {
-      uint8_t inByte = transport->read();
-    }
-
-    if (millis() - lastSent >= transmitRate && numDimensions > 0) {
-      bool wroteValue = false;
-      bool hasValue = !isDeltaMode;
-      for (uint16_t i = 0; i < numDimensions; i++) {
-        updateHasValue(i);
-        if (dimensions[i]->hasNewTransmitValue) {
-          dimensions[i]->hasNewTransmitValue = false;
-          hasValue = true;
-        }
-      }
-      if (hasValue) {
-        for (uint16_t i = 0; i < numDimensions; i++) {
-          if (dimensions[i]->hasValue) {
-            switch (dimensions[i]->type) {
-              case DataPointType::BOOLEAN: {
-                transport->print((unsigned int)(dimensions[i]->value.v_bool));
-                break;
-              }
-              case DataPointType::UINT8: {
-                transport->print((unsigned int)(dimensions[i]->value.v_uint8));
-                break;
-              }
-              case DataPointType::UINT16: {
-                transport->print((unsigned int)(dimensions[i]->value.v_uint16));
-                break;
-              }
-              case DataPointType::UINT32: {
-                transport->print((unsigned long)(dimensions[i]->value.v_uint32));
-                break;
-              }
-              case DataPointType::UINT64: {
-                transport->print((unsigned long)(dimensions[i]->value.v_uint64));
-                break;
-              }
-              case DataPointType::INT8: {
-                transport->print((int)(dimensions[i]->value.v_int8));
-                break;
-              }
-              case DataPointType::INT16: {
-                transport->print((int)(dimensions[i]->value.v_int16));
-                break;
-              }
-              case DataPointType::INT32: {
-                transport->print((long)(dimensions[i]->value.v_int32));
-                break;
-              }
-              case DataPointType::INT64: {
-                transport->print((long)(dimensions[i]->value.v_int64));
-                break;
-              }
-              case DataPointType::FLOAT32: {
-                transport->print((float)(dimensions[i]->value.v_float32));
-                break;
-              }
-              default: {
-                break;
-              }
-            }
-          } else {
-            transport->write('0');
-          }
-          transport->write(' ');
-        }
-        transport->write('\n');
-      }
-      lastSent = millis();
-    }
-  } else {
-    // Binary mode
-    while (transport->available() > 0) {
-      uint8_t inByte = transport->read();
-      if (rxIndex >= 32) {
-        rxIndex = 0;
-      }
-      rxBuffer[rxIndex++] = inByte;
-
-      // 0x0 pads the end of a packet
-      // Reset the buffer and parse if possible
-      if (inByte == 0x0) {
-        if (rxIndex > 6) {
-          // If we see 0x0 and have contents in the buffer, read packet
-          // Minimum length of a packet is 5 bytes:
-          // - Checksum (1 byte)
-          // - Checksum correction byte (1 byte)
-          // - COBS header byte (1 byte)
-          // - Key (1+ byte)
-          // - Type (1+ byte)
-          // - Value (1+ byte)
-          // - Packet boundary (0x0, 1 byte)
-          
-          uint8_t checksumValue = (uint8_t)rxBuffer[0];
-          uint8_t paddingByteValue = (uint8_t)rxBuffer[1];
-
-          // 1 - Validate checksum
-          uint8_t checksum = 0;
-          for (uint16_t bufferIdx = 0; bufferIdx < rxIndex; bufferIdx++) {
-            checksum += (uint8_t)rxBuffer[bufferIdx];
-          }
-          // Get padding/flag byte
-
-          if (checksum == 0xFF) {
-            // Expand COBS encoded binary string
-            // Offset the array by the two checksum bytes that are not contained in the cobs encoding
-            size_t packetLength = UnStuffData(rxBuffer + 2, rxIndex - 2, tempBuffer);
-
-            // Process messagepack structure
-            mpack_reader_t reader;
-            mpack_reader_init_data(&reader, tempBuffer, packetLength);
-
-            uint16_t key = mpack_expect_u16(&reader);
-            uint8_t type = mpack_expect_u8(&reader);
-            DataPointValue value;
-
-            switch ((DataPointType)type) {
-              case DataPointType::BOOLEAN: {
-                value.v_bool = mpack_expect_bool(&reader);
-                break;
-              }
-              case DataPointType::UINT8: {
-                value.v_uint8 = mpack_expect_u8(&reader);
-                break;
-              }
-              case DataPointType::UINT16: {
-                value.v_uint16 = mpack_expect_u16(&reader);
-                break;
-              }
-              case DataPointType::UINT32: {
-                value.v_uint32 = mpack_expect_u32(&reader);
-                break;
-              }
-              case DataPointType::UINT64: {
-                value.v_uint64 = mpack_expect_u64(&reader);
-                break;
-              }
-              case DataPointType::INT8: {
-                value.v_int8 = mpack_expect_i8(&reader);
-                break;
-              }
-              case DataPointType::INT16: {
-                value.v_int16 = mpack_expect_i16(&reader);
-                break;
-              }
-              case DataPointType::INT32: {
-                value.v_int32 = mpack_expect_i32(&reader);
-                break;
-              }
-              case DataPointType::INT64: {
-                value.v_int64 = mpack_expect_i64(&reader);
-                break;
-              }
-              case DataPointType::FLOAT32: {
-                value.v_float32 = mpack_expect_float(&reader);
-                break;
-              }
-            }
-
-            if (mpack_reader_destroy(&reader) == mpack_ok) {
-              // Write packet values as a data point
-              // Find dimension with key matching from the data
-              if (type < (uint8_t)DataPointType::NUM_TYPES) {
-                for (uint16_t i = 0; i < numDimensions; i++) {
-                  if (dimensions[i]->key = key) {
-                    dimensions[i]->value = value;
-                    dimensions[i]->type = (DataPointType)type;
-                    dimensions[i]->hasValue = true;
-                    dimensions[i]->hasNewTransmitValue = false;
-                    dimensions[i]->hasNewReceivedValue = true;
-                    dimensions[i]->lastTimestamp = millis();
-                    break;
-                  }
-                }
-              }
-
-
-            } else {
-              numDroppedRxPackets++;
-            }
-          } else {
-            numDroppedRxPackets++;
-          }
-        }
-        rxIndex = 0;
-      }
+#if TELEMETRYJET_RX
+const ReceiveStatistics* TelemetryJet::getReceiveStatistics(Stream* stream) {
+  if (stream != NULL && stream == transport) {
+    return &rxState.statistics;
+  }
+  for (uint8_t i = 0; i < numTransports; i++) {
+    if (transports[i]->mode == TransportMode::BINARY && transports[i]->stream == stream) {
+      return &transports[i]->rxState.statistics;
     }
-    if (millis() - lastSent >= transmitRate && numDimensions > 0) {
-      mpack_writer_t writer;
-      size_t packetLength;
-      for (uint16_t i = 0; i < numDimensions; i++) {
-        updateHasValue(i);
-        if (dimensions[i]->hasValue && (dimensions[i]->hasNewTransmitValue || !isDeltaMode)) {
-          dimensions[i]->hasNewTransmitValue = false;
-          mpack_writer_init(&writer, tempBuffer, 32);
-
-          // Write key and type headers
-          mpack_write_u16(&writer, (uint16_t)dimensions[i]->key);
-          mpack_write_u8(&writer, (uint8_t)dimensions[i]->type);
-
-          // Write data
-          switch (dimensions[i]->type) {
-            case DataPointType::BOOLEAN: {
-              mpack_write_bool(&writer, dimensions[i]->value.v_bool);
-              break;
-            }
-            case DataPointType::UINT8: {
-              mpack_write_u8(&writer, dimensions[i]->value.v_uint8);
-              break;
-            }
-            case DataPointType::UINT16: {
-              mpack_write_u16(&writer, dimensions[i]->value.v_uint16);
-              break;
-            }
-            case DataPointType::UINT32: {
-              mpack_write_u32(&writer, dimensions[i]->value.v_uint32);
-              break;
-            }
-            case DataPointType::UINT64: {
-              mpack_write_u64(&writer, dimensions[i]->value.v_uint64);
-              break;
-            }
-            case DataPointType::INT8: {
-              mpack_write_i8(&writer, dimensions[i]->value.v_int8);
-              break;
-            }
-            case DataPointType::INT16: {
-              mpack_write_i16(&writer, dimensions[i]->value.v_int16);
-              break;
-            }
-            case DataPointType::INT32: {
-              mpack_write_i32(&writer, dimensions[i]->value.v_int32);
-              break;
-            }
-            case DataPointType::INT64: {
-              mpack_write_i64(&writer, dimensions[i]->value.v_int64);
-              break;
-            }
-            case DataPointType::FLOAT32: {
-              mpack_write_float(&writer, dimensions[i]->value.v_float32);
-              break;
-            }
-          }
-
-          mpack_writer_destroy(&writer);
-          packetLength = mpack_writer_buffer_used(&writer);
-
-          // Use COBS (Consistent Overhead Byte Stuffing)
-          // https://en.wikipedia.org/wiki/Consistent_Overhead_Byte_Stuffing
-          // to replace all 0x0 bytes in the packet.
-          // This way, we can use 0x0 as a packet frame marker. 
-          packetLength = StuffData(tempBuffer, packetLength, txBuffer);
-
-          // Compute checksum and add to front of the packet
-          // We never want the checksum to == 0,
-          // because that would complicate the COBS & packet frame marker logic.
-          // If the checksum is going to be 0, add a single bit so that it won't be.
-          uint8_t checksum = 0;
-          for (uint16_t bufferIdx = 0; bufferIdx < packetLength; bufferIdx++) {
-            checksum += (uint8_t)txBuffer[bufferIdx];
-          }
-          checksum = 0xFF - (checksum + 0x01);
-
-          uint8_t checksumCorrectionByte = 0x01;
-          if (checksum == 0x0) {
-            // Increment byte in the front of the packet to correct the checksum
-            // If the checksum was previously 0x0 (0), it will now be 0xFF (255).
-            checksumCorrectionByte += 1;
-            checksum = 0xFF; 
-          }
+  }
+  return NULL;
+}
 
-          // Write checksum and checksum correction byte
-          transport->write((uint8_t)checksum);
-          transport->write((uint8_t)checksumCorrectionByte);
+const ReceiveStatistics* TelemetryJet::getBusNodeStatistics(uint8_t address) {
+  if (busRole != BusRole::MASTER || address < 1 || address > busNumNodes) {
+    return NULL;
+  }
+  return &busNodeStates[address - 1].statistics;
+}
 
-          // Write buffer
-          for (uint16_t bufferIdx = 0; bufferIdx < packetLength; bufferIdx++) {
-            transport->write((uint8_t)txBuffer[bufferIdx]);
-          }
-          numTxPackets++;
-        }
-      }
-      lastSent = millis();
+const ReceiveStatistics* TelemetryJet::getReceiveStatistics(CanDriver* driver) {
+  for (uint8_t i = 0; i < numTransports; i++) {
+    if (transports[i]->mode == TransportMode::CAN && transports[i]->can == driver) {
+      return &transports[i]->rxState.statistics;
     }
   }
+  return NULL;
 }
+#endif
 
 Dimension TelemetryJet::createDimension(uint16_t key, uint32_t timeoutAge = 0) {
   // Resize dimension array if it is full
@@ -403,6 +2813,14 @@ Dimension TelemetryJet::createDimension(uint16_t key, uint32_t timeoutAge = 0) {
     }
     free(dimensions);
     dimensions = newDimensionArray;
+
+    // Grow the subscription bitmap by one byte to match, and subscribe the new slots
+    uint8_t* newSubscriptions = (uint8_t*) malloc((dimensionCacheLength + 8) / 8);
+    memcpy(newSubscriptions, subscriptions, dimensionCacheLength / 8);
+    newSubscriptions[dimensionCacheLength / 8] = 0xFF;
+    free(subscriptions);
+    subscriptions = newSubscriptions;
+
     dimensionCacheLength = dimensionCacheLength + 8;
   }
 
@@ -416,6 +2834,16 @@ Dimension TelemetryJet::createDimension(uint16_t key, uint32_t timeoutAge = 0) {
   dimensions[dimensionId]->hasValue = false;
   dimensions[dimensionId]->hasNewReceivedValue = false;
   dimensions[dimensionId]->hasNewTransmitValue = false;
+  dimensions[dimensionId]->priority = 0;
+  dimensions[dimensionId]->isUrgent = false;
+  dimensions[dimensionId]->isReliable = false;
+  dimensions[dimensionId]->rateDivisor = 1;
+  dimensions[dimensionId]->hasReadRequest = false;
+  dimensions[dimensionId]->hasFixedType = false;
+  dimensions[dimensionId]->binding = DataPointBinding::NONE;
+#if TELEMETRYJET_RX
+  dimensions[dimensionId]->receiveCallback = NULL;
+#endif
   if (timeoutAge > 0) {
     dimensions[dimensionId]->hasTimeout = true;
     dimensions[dimensionId]->timeoutInterval = timeoutAge;
@@ -424,338 +2852,290 @@ Dimension TelemetryJet::createDimension(uint16_t key, uint32_t timeoutAge = 0) {
     dimensions[dimensionId]->timeoutInterval = 0;
   }
   dimensions[dimensionId]->lastTimestamp = 0;
+  dimensions[dimensionId]->version = 0;
+  dimensions[dimensionId]->arrayLength = 0;
+  dimensions[dimensionId]->arrayCapacity = 0;
+  dimensions[dimensionId]->arrayValues = NULL;
+  dimensions[dimensionId]->scale = NULL;
   return Dimension(dimensionId, this);
 }
 
+// Store a value written by a setter, with its type, flags and timestamp
+void Dimension::updateValue(DataPointType type, const DataPointValue& value) {
+  DataPoint* point = _parent->dimensions[_id];
+  DataPointValue newValue = value;
+  if (!matchFixedType(point, type, newValue)) {
+    return;
+  }
+  if (_parent->isInTransaction) {
+    _parent->holdTransactionValue(_id, type, newValue, NULL, 0);
+    return;
+  }
+  beginWrite(point);
+  point->type = type;
+  point->value = newValue;
+  point->arrayLength = 0;
+  point->lastTimestamp = millis();
+  point->hasValue = true;
+  endWrite(point);
+  updateFlags(point);
+}
+
+void Dimension::updateArray(DataPointType type, const void* values, uint8_t length) {
+  DataPoint* point = _parent->dimensions[_id];
+  uint8_t size = valueSize(type);
+  // Bound dimensions hold a single value, and typed dimensions only hold arrays of their own type
+  bool isFixedMismatch = point->hasFixedType && point->type != type;
+  if (length == 0 || point->binding != DataPointBinding::NONE || isFixedMismatch) {
+    return;
+  }
+  if (_parent->isInTransaction) {
+    DataPointValue noValue = {};
+    _parent->holdTransactionValue(_id, type, noValue, values, length);
+    return;
+  }
+  if (!reserveArray(point, length * size)) {
+    return;
+  }
+  beginWrite(point);
+  point->type = type;
+  memcpy(point->arrayValues, values, length * size);
+  point->arrayLength = length;
+  point->lastTimestamp = millis();
+  point->hasValue = true;
+  endWrite(point);
+  updateFlags(point);
+}
+
+// Record the flags for a value that was just written, and queue it for transmit
+void Dimension::updateFlags(DataPoint* point) {
+  point->hasNewReceivedValue = false;
+  point->hasNewTransmitValue = true;
+  if (point->isUrgent) {
+    _parent->hasUrgentValue = true;
+  }
+}
+
 void Dimension::setBool(bool value) {
-  _parent->dimensions[_id]->value.v_bool = value;
-  _parent->dimensions[_id]->type = DataPointType::BOOLEAN;
-  _parent->dimensions[_id]->hasValue = true;
-  _parent->dimensions[_id]->hasNewReceivedValue = false;
-  _parent->dimensions[_id]->hasNewTransmitValue = true;
-  _parent->dimensions[_id]->lastTimestamp = millis();
+  setValue(value);
 }
 
 void Dimension::setUInt8(uint8_t value) {
-  _parent->dimensions[_id]->value.v_uint8 = value;
-  _parent->dimensions[_id]->type = DataPointType::UINT8;
-  _parent->dimensions[_id]->hasValue = true;
-  _parent->dimensions[_id]->hasNewReceivedValue = false;
-  _parent->dimensions[_id]->hasNewTransmitValue = true;
-  _parent->dimensions[_id]->lastTimestamp = millis();
+  setValue(value);
 }
 
 void Dimension::setUInt16(uint16_t value) {
-  _parent->dimensions[_id]->value.v_uint16 = value;
-  _parent->dimensions[_id]->type = DataPointType::UINT16;
-  _parent->dimensions[_id]->hasValue = true;
-  _parent->dimensions[_id]->hasNewReceivedValue = false;
-  _parent->dimensions[_id]->hasNewTransmitValue = true;
-  _parent->dimensions[_id]->lastTimestamp = millis();
+  setValue(value);
 }
 
 void Dimension::setUInt32(uint32_t value) {
-  
-  _parent->dimensions[_id]->value.v_uint32 = value;
-  _parent->dimensions[_id]->type = DataPointType::UINT32;
-  _parent->dimensions[_id]->hasValue = true;
-  _parent->dimensions[_id]->hasNewReceivedValue = false;
-  _parent->dimensions[_id]->hasNewTransmitValue = true;
-  _parent->dimensions[_id]->lastTimestamp = millis();
+  setValue(value);
 }
 
+#if TELEMETRYJET_64BIT_TYPES
 void Dimension::setUInt64(uint64_t value) {
-  _parent->dimensions[_id]->value.v_uint64 = value;
-  _parent->dimensions[_id]->type = DataPointType::UINT64;
-  _parent->dimensions[_id]->hasValue = true;
-  _parent->dimensions[_id]->hasNewReceivedValue = false;
-  _parent->dimensions[_id]->hasNewTransmitValue = true;
-  _parent->dimensions[_id]->lastTimestamp = millis();
+  setValue(value);
 }
+#endif
 
 void Dimension::setInt8(int8_t value) {
-  _parent->dimensions[_id]->value.v_int8 = value;
-  _parent->dimensions[_id]->type = DataPointType::INT8;
-  _parent->dimensions[_id]->hasValue = true;
-  _parent->dimensions[_id]->hasNewReceivedValue = false;
-  _parent->dimensions[_id]->hasNewTransmitValue = true;
-  _parent->dimensions[_id]->lastTimestamp = millis();
+  setValue(value);
 }
 
 void Dimension::setInt16(int16_t value) {
-  _parent->dimensions[_id]->value.v_int16 = value;
-  _parent->dimensions[_id]->type = DataPointType::INT16;
-  _parent->dimensions[_id]->hasValue = true;
-  _parent->dimensions[_id]->hasNewReceivedValue = false;
-  _parent->dimensions[_id]->hasNewTransmitValue = true;
-  _parent->dimensions[_id]->lastTimestamp = millis();
+  setValue(value);
 }
 
 void Dimension::setInt32(int32_t value) {
-  _parent->dimensions[_id]->value.v_int32 = value;
-  _parent->dimensions[_id]->type = DataPointType::INT32;
-  _parent->dimensions[_id]->hasValue = true;
-  _parent->dimensions[_id]->hasNewReceivedValue = false;
-  _parent->dimensions[_id]->hasNewTransmitValue = true;
-  _parent->dimensions[_id]->lastTimestamp = millis();
+  setValue(value);
 }
 
+#if TELEMETRYJET_64BIT_TYPES
 void Dimension::setInt64(int64_t value) {
-  _parent->dimensions[_id]->value.v_int64 = value;
-  _parent->dimensions[_id]->type = DataPointType::INT64;
-  _parent->dimensions[_id]->hasValue = true;
-  _parent->dimensions[_id]->hasNewReceivedValue = false;
-  _parent->dimensions[_id]->hasNewTransmitValue = true;
-  _parent->dimensions[_id]->lastTimestamp = millis();
+  setValue(value);
 }
+#endif
 
 void Dimension::setFloat32(float value) {
-  _parent->dimensions[_id]->value.v_float32 = value;
-  _parent->dimensions[_id]->type = DataPointType::FLOAT32;
-  _parent->dimensions[_id]->hasValue = true;
-  _parent->dimensions[_id]->hasNewReceivedValue = false;
-  _parent->dimensions[_id]->hasNewTransmitValue = true;
-  _parent->dimensions[_id]->lastTimestamp = millis();
+  setValue(value);
 }
 
-bool Dimension::getBool(bool defaultValue = false) {
+void Dimension::setFloat16(float value) {
+  DataPointValue newValue;
+  newValue.v_float16 = floatToHalf(value);
+  updateValue(DataPointType::FLOAT16, newValue);
+}
+
+// Read the stored value as type T, converting UP from any compatible stored type
+template <typename T>
+T Dimension::getValue(T defaultValue) {
   if (!hasValue()) {
     return defaultValue;
   }
-  
-  if (_parent->dimensions[_id]->type == DataPointType::BOOLEAN) {
-    return _parent->dimensions[_id]->value.v_bool;
-  } else {
+  DataPoint* point = _parent->dimensions[_id];
+  if (point->arrayLength > 0 || !isCompatibleType(point->type, DataPointTraits<T>::type)) {
     return defaultValue;
   }
+  return convertValue<T>(point->type, point->value);
+}
+
+bool Dimension::getBool(bool defaultValue = false) {
+  return getValue<bool>(defaultValue);
 }
 
 uint8_t Dimension::getUInt8(uint8_t defaultValue = 0) {
-  if (!hasValue()) {
-    return defaultValue;
-  }
-  
-  if (_parent->dimensions[_id]->type == DataPointType::UINT8) {
-    return _parent->dimensions[_id]->value.v_uint8;
-  } else {
-    return (uint8_t)getBool(defaultValue);
-  }
+  return getValue<uint8_t>(defaultValue);
 }
 
 uint16_t Dimension::getUInt16(uint16_t defaultValue = 0) {
-  if (!hasValue()) {
-    return defaultValue;
-  }
-  
-  if (_parent->dimensions[_id]->type == DataPointType::UINT16) {
-    return _parent->dimensions[_id]->value.v_uint16;
-  } else {
-    return (uint16_t)getUInt8(defaultValue);
-  }
+  return getValue<uint16_t>(defaultValue);
 }
 
 uint32_t Dimension::getUInt32(uint32_t defaultValue = 0) {
-  if (!hasValue()) {
-    return defaultValue;
-  }
-  
-  if (_parent->dimensions[_id]->type == DataPointType::UINT32) {
-    return _parent->dimensions[_id]->value.v_uint32;
-  } else {
-    return (uint32_t)getUInt16(defaultValue);
-  }
+  return getValue<uint32_t>(defaultValue);
 }
 
+#if TELEMETRYJET_64BIT_TYPES
 uint64_t Dimension::getUInt64(uint64_t defaultValue = 0) {
-  if (!hasValue()) {
-    return defaultValue;
-  }
-  
-  if (_parent->dimensions[_id]->type == DataPointType::UINT64) {
-    return _parent->dimensions[_id]->value.v_uint64;
-  } else {
-    return (uint64_t)getUInt32(defaultValue);
-  }
+  return getValue<uint64_t>(defaultValue);
 }
 
+#endif
+
 int8_t Dimension::getInt8(int8_t defaultValue = 0) {
-  if (!hasValue()) {
-    return defaultValue;
-  }
-  
-  if (_parent->dimensions[_id]->type == DataPointType::INT8) {
-    return _parent->dimensions[_id]->value.v_int8;
-  } else {
-    return defaultValue;
-  }
+  return getValue<int8_t>(defaultValue);
 }
 
 int16_t Dimension::getInt16(int16_t defaultValue = 0) {
-  if (!hasValue()) {
-    return defaultValue;
-  }
-  
-  if (_parent->dimensions[_id]->type == DataPointType::INT16) {
-    return _parent->dimensions[_id]->value.v_int16;
-  } else {
-    return (int16_t)getInt8(defaultValue);
-  }
+  return getValue<int16_t>(defaultValue);
 }
 
 int32_t Dimension::getInt32(int32_t defaultValue = 0) {
-  if (!hasValue()) {
-    return defaultValue;
-  }
-  
-  if (_parent->dimensions[_id]->type == DataPointType::INT32) {
-    return _parent->dimensions[_id]->value.v_int32;
-  } else {
-    return (int32_t)getInt16(defaultValue);
-  }
+  return getValue<int32_t>(defaultValue);
 }
 
+#if TELEMETRYJET_64BIT_TYPES
 int64_t Dimension::getInt64(int64_t defaultValue = 0) {
-  if (!hasValue()) {
-    return defaultValue;
-  }
-  
-  if (_parent->dimensions[_id]->type == DataPointType::INT64) {
-    return _parent->dimensions[_id]->value.v_int64;
-  } else {
-    return (int64_t)getInt32(defaultValue);
-  }
+  return getValue<int64_t>(defaultValue);
 }
 
-float Dimension::getFloat32(float defaultValue = 0.0) {
-  if (!hasValue()) {
-    return defaultValue;
-  }
+#endif
 
-  if (_parent->dimensions[_id]->type == DataPointType::FLOAT32) {
-    return _parent->dimensions[_id]->value.v_float32;
-  } else {
+float Dimension::getFloat32(float defaultValue) {
+  return getValue<float>(defaultValue);
+}
+
+float Dimension::getFloat16(float defaultValue) {
+  DataPoint* point = _parent->dimensions[_id];
+  if (!hasType(DataPointType::FLOAT16, false) || point->arrayLength > 0) {
     return defaultValue;
   }
+  return halfToFloat(point->value.v_float16);
 }
 
-bool Dimension::hasBool(bool exact = false) {
+bool Dimension::hasType(DataPointType type, bool exact) {
   if (!hasValue()) {
     return false;
   }
-  if (_parent->dimensions[_id]->type == DataPointType::BOOLEAN) {
-    return true;
-  }
-  if (!exact) {
-    return false;
+  if (exact) {
+    return _parent->dimensions[_id]->type == type;
   }
+  return isCompatibleType(_parent->dimensions[_id]->type, type);
 }
 
-bool  Dimension::hasUInt8  (bool exact = false) {
-  if (!hasValue()) {
-    return false;
-  }
-  if (_parent->dimensions[_id]->type == DataPointType::UINT8) {
-    return true;
-  }
-  if (!exact) {
-    return hasBool();
-  }
+bool Dimension::hasBool(bool exact = false) {
+  return hasType(DataPointType::BOOLEAN, exact);
 }
 
-bool Dimension::hasUInt16 (bool exact = false) {
-  if (!hasValue()) {
-    return false;
-  }
-  if (_parent->dimensions[_id]->type == DataPointType::UINT16) {
-    return true;
-  }
-  if (!exact) {
-    return hasUInt8();
-  }
+bool Dimension::hasUInt8(bool exact = false) {
+  return hasType(DataPointType::UINT8, exact);
 }
 
-bool Dimension::hasUInt32 (bool exact = false) {
-  if (!hasValue()) {
-    return false;
-  }
-  if (_parent->dimensions[_id]->type == DataPointType::UINT32) {
-    return true;
-  }
-  if (!exact) {
-    return hasUInt16();
-  }
+bool Dimension::hasUInt16(bool exact = false) {
+  return hasType(DataPointType::UINT16, exact);
 }
 
-bool Dimension::hasUInt64 (bool exact = false) {
-  if (!hasValue()) {
-    return false;
-  }
-  if (_parent->dimensions[_id]->type == DataPointType::UINT64) {
-    return true;
-  }
-  if (!exact) {
-    return hasUInt32();
-  }
+bool Dimension::hasUInt32(bool exact = false) {
+  return hasType(DataPointType::UINT32, exact);
 }
 
-bool Dimension::hasInt8   (bool exact = false) {
-  if (!hasValue()) {
-    return false;
-  }
-  if (_parent->dimensions[_id]->type == DataPointType::INT8) {
-    return true;
-  }
-  if (!exact) {
-    return false;
-  }
+#if TELEMETRYJET_64BIT_TYPES
+bool Dimension::hasUInt64(bool exact = false) {
+  return hasType(DataPointType::UINT64, exact);
 }
 
-bool Dimension::hasInt16  (bool exact = false) {
-  if (!hasValue()) {
-    return false;
-  }
-  if (_parent->dimensions[_id]->type == DataPointType::INT16) {
-    return true;
-  }
-  if (!exact) {
-    return hasInt8();
-  }
+#endif
+
+bool Dimension::hasInt8(bool exact = false) {
+  return hasType(DataPointType::INT8, exact);
 }
 
-bool Dimension::hasInt32  (bool exact = false) {
-  if (!hasValue()) {
-    return false;
-  }
-  if (_parent->dimensions[_id]->type == DataPointType::INT32) {
-    return true;
-  }
-  if (!exact) {
-    return hasInt16();
-  }
+bool Dimension::hasInt16(bool exact = false) {
+  return hasType(DataPointType::INT16, exact);
 }
 
-bool Dimension::hasInt64  (bool exact = false) {
-  if (!hasValue()) {
-    return false;
-  }
-  if (_parent->dimensions[_id]->type == DataPointType::INT64) {
-    return true;
-  }
-  if (!exact) {
-    return hasInt32();
-  }
+bool Dimension::hasInt32(bool exact = false) {
+  return hasType(DataPointType::INT32, exact);
+}
+
+#if TELEMETRYJET_64BIT_TYPES
+bool Dimension::hasInt64(bool exact = false) {
+  return hasType(DataPointType::INT64, exact);
 }
 
+#endif
+
 bool Dimension::hasFloat32(bool exact = false) {
+  return hasType(DataPointType::FLOAT32, exact);
+}
+
+bool Dimension::hasFloat16(bool exact = false) {
+  return hasType(DataPointType::FLOAT16, exact);
+}
+
+void Dimension::bindSource(DataPointType type, DataPointBinding binding, DataPointSource source) {
+  DataPoint* point = _parent->dimensions[_id];
+  beginWrite(point);
+  point->type = type;
+  point->arrayLength = 0;
+  point->hasValue = false;
+  endWrite(point);
+  // The sampler or variable is read with this type, so it can't change while bound
+  point->hasFixedType = true;
+  point->binding = binding;
+  point->source = source;
+}
+
+void Dimension::unbind() {
+  _parent->dimensions[_id]->binding = DataPointBinding::NONE;
+}
+
+uint16_t Dimension::getKey() {
+  return _parent->dimensions[_id]->key;
+}
+
+uint8_t Dimension::getArrayValues(DataPointType type, void* values, uint8_t maxLength) {
   if (!hasValue()) {
-    return false;
+    return 0;
   }
-  if (_parent->dimensions[_id]->type == DataPointType::FLOAT32) {
-    return true;
+  DataPoint* point = _parent->dimensions[_id];
+  if (point->arrayLength == 0 || !isCompatibleType(point->type, type)) {
+    return 0;
   }
-  if (!exact) {
-    return false;
+  uint8_t length = (point->arrayLength < maxLength) ? point->arrayLength : maxLength;
+  uint8_t storedSize = valueSize(point->type);
+  uint8_t size = valueSize(type);
+  for (uint8_t i = 0; i < length; i++) {
+    DataPointValue element;
+    memcpy(&element, (uint8_t*)point->arrayValues + i * storedSize, storedSize);
+    element = convertValue(point->type, element, type);
+    memcpy((uint8_t*)values + i * size, &element, size);
   }
+  return length;
+}
+
+uint8_t Dimension::getArrayLength() {
+  return _parent->dimensions[_id]->arrayLength;
 }
 
 DataPointType Dimension::getType() {
@@ -763,7 +3143,31 @@ DataPointType Dimension::getType() {
 }
 
 void Dimension::clearValue() {
-  _parent->dimensions[_id]->hasValue = false;
+  DataPoint* point = _parent->dimensions[_id];
+  beginWrite(point);
+  point->hasValue = false;
+  endWrite(point);
+}
+
+// Sequence lock reader: copy the value, then check that no write started or finished meanwhile
+bool Dimension::getSnapshot(DataPointSnapshot* snapshot) {
+  DataPoint* point = _parent->dimensions[_id];
+  for (uint8_t attempt = 0; attempt < TELEMETRYJET_SNAPSHOT_RETRIES; attempt++) {
+    uint8_t version = point->version;
+    TELEMETRYJET_MEMORY_BARRIER();
+    if (version & 1) {
+      continue;
+    }
+    snapshot->type = point->type;
+    snapshot->value = point->value;
+    snapshot->timestamp = point->lastTimestamp;
+    snapshot->hasValue = point->hasValue && !(point->hasTimeout && (millis() - snapshot->timestamp) > point->timeoutInterval);
+    TELEMETRYJET_MEMORY_BARRIER();
+    if (point->version == version) {
+      return true;
+    }
+  }
+  return false;
 }
 
 // Check if a value is present, and check/update timeout at the same time
@@ -778,6 +3182,126 @@ bool Dimension::hasValue() {
   return true;
 }
 
+bool TelemetryJet::setPublishQueueSize(uint8_t size) {
+  // One slot is always left empty, so a full ring can be told apart from an empty one
+  PublishedValue* queue = NULL;
+  uint8_t slots = 0;
+  if (size > 0) {
+    slots = (size < 255) ? size + 1 : 255;
+    queue = (PublishedValue*) malloc(sizeof(PublishedValue) * slots);
+    if (queue == NULL) {
+      return false;
+    }
+  }
+  drainPublishQueue();
+  publishQueueSlots = 0;
+  TELEMETRYJET_MEMORY_BARRIER();
+  free(publishQueue);
+  publishQueue = queue;
+  publishHead = 0;
+  publishTail = 0;
+  TELEMETRYJET_MEMORY_BARRIER();
+  publishQueueSlots = slots;
+  return true;
+}
+
+// Producer side of the publish ring, called from an interrupt handler
+bool TelemetryJet::publishValue(uint16_t id, DataPointType type, DataPointValue value) {
+  if (publishQueueSlots == 0) {
+    return false;
+  }
+  uint8_t head = publishHead;
+  uint8_t next = (head + 1) % publishQueueSlots;
+  if (next == publishTail) {
+    publishDropped++;
+    return false;
+  }
+  PublishedValue* entry = &publishQueue[head];
+  entry->id = id;
+  entry->type = type;
+  entry->value = value;
+  entry->timestamp = millis();
+  // The entry must be complete before update() can see it
+  TELEMETRYJET_MEMORY_BARRIER();
+  publishHead = next;
+  return true;
+}
+
+// Consumer side of the publish ring: store published values in their dimensions, oldest first
+void TelemetryJet::drainPublishQueue() {
+  if (publishQueueSlots == 0) {
+    return;
+  }
+  uint8_t dropped = publishDropped;
+  linkStatistics.publishOverflows += (uint8_t)(dropped - publishDroppedCounted);
+  publishDroppedCounted = dropped;
+
+  uint8_t tail = publishTail;
+  uint8_t head = publishHead;
+  TELEMETRYJET_MEMORY_BARRIER();
+  while (tail != head) {
+    PublishedValue* entry = &publishQueue[tail];
+    DataPoint* point = dimensions[entry->id];
+    DataPointType type = entry->type;
+    DataPointValue value = entry->value;
+    tail = (tail + 1) % publishQueueSlots;
+    if (!matchFixedType(point, type, value)) {
+      continue;
+    }
+    beginWrite(point);
+    point->type = type;
+    point->value = value;
+    point->arrayLength = 0;
+    point->lastTimestamp = entry->timestamp;
+    point->hasValue = true;
+    endWrite(point);
+    point->hasNewReceivedValue = false;
+    point->hasNewTransmitValue = true;
+    if (point->isUrgent) {
+      hasUrgentValue = true;
+    }
+  }
+  // The slots may only be reused once they have been read
+  TELEMETRYJET_MEMORY_BARRIER();
+  publishTail = tail;
+}
+
+// Read the current value of a bound dimension
+// The value is queued for transmit if it changed, like a call to a setter.
+void TelemetryJet::sampleDimension(DataPoint* point) {
+  if (point->binding == DataPointBinding::NONE) {
+    return;
+  }
+  DataPointValue value = point->value;
+  if (point->binding == DataPointBinding::VARIABLE) {
+    memcpy(&value, point->source.variable, valueSize(point->type));
+  } else {
+    switch (point->type) {
+      case DataPointType::BOOLEAN: callSampler<bool>(point->source, value); break;
+      case DataPointType::UINT8:   callSampler<uint8_t>(point->source, value); break;
+      case DataPointType::UINT16:  callSampler<uint16_t>(point->source, value); break;
+      case DataPointType::UINT32:  callSampler<uint32_t>(point->source, value); break;
+      case DataPointType::INT8:    callSampler<int8_t>(point->source, value); break;
+      case DataPointType::INT16:   callSampler<int16_t>(point->source, value); break;
+      case DataPointType::INT32:   callSampler<int32_t>(point->source, value); break;
+      case DataPointType::FLOAT32: callSampler<float>(point->source, value); break;
+#if TELEMETRYJET_64BIT_TYPES
+      case DataPointType::UINT64:  callSampler<uint64_t>(point->source, value); break;
+      case DataPointType::INT64:   callSampler<int64_t>(point->source, value); break;
+#endif
+      default: break;
+    }
+  }
+  if (!point->hasValue || memcmp(&value, &point->value, valueSize(point->type)) != 0) {
+    point->hasNewTransmitValue = true;
+  }
+  beginWrite(point);
+  point->value = value;
+  point->lastTimestamp = millis();
+  point->hasValue = true;
+  endWrite(point);
+}
+
 void TelemetryJet::updateHasValue(int id) {
   if (dimensions[id]->hasTimeout && ((millis() - dimensions[id]->lastTimestamp) > dimensions[id]->timeoutInterval)) {
     dimensions[id]->hasValue = false;
@@ -808,4 +3332,74 @@ bool Dimension::hasNewValue() {
     return true;
   }
   return false;
-}
\ No newline at end of file
+}
+
+void Dimension::setPriority(uint8_t priority) {
+  _parent->dimensions[_id]->priority = priority;
+}
+
+uint8_t Dimension::getPriority() {
+  return _parent->dimensions[_id]->priority;
+}
+
+void Dimension::setUrgent(bool urgent) {
+  _parent->dimensions[_id]->isUrgent = urgent;
+}
+
+bool Dimension::isUrgent() {
+  return _parent->dimensions[_id]->isUrgent;
+}
+
+#if TELEMETRYJET_RX
+bool Dimension::setReliable(bool reliable) {
+  if (reliable && !_parent->hasReliableDimension) {
+    // The retransmit window is only allocated once the first reliable dimension is created
+    // If it can't be, the old buffers are kept, and so is the dimension's unreliable delivery.
+    _parent->hasReliableDimension = true;
+    if (!_parent->setMaxFrameSize(_parent->maxFrameSize)) {
+      _parent->hasReliableDimension = false;
+      _parent->dimensions[_id]->isReliable = false;
+      return false;
+    }
+  }
+  _parent->dimensions[_id]->isReliable = reliable;
+  return true;
+}
+
+#endif
+
+bool Dimension::isReliable() {
+  return _parent->dimensions[_id]->isReliable;
+}
+
+bool Dimension::setScale(float minimum, float maximum, float resolution) {
+  DataPoint* point = _parent->dimensions[_id];
+  float steps = (maximum - minimum) / resolution + 0.5f;
+  if (!(resolution > 0) || !(steps >= 1.0f) || steps >= 4294967296.0f || !reserveScale(point)) {
+    clearScale();
+    return false;
+  }
+  point->scale->minimum = minimum;
+  point->scale->resolution = resolution;
+  point->scale->steps = (uint32_t)steps;
+  point->scale->announceCountdown = 0;
+  return true;
+}
+
+void Dimension::clearScale() {
+  DataPoint* point = _parent->dimensions[_id];
+  free(point->scale);
+  point->scale = NULL;
+}
+
+bool Dimension::isScaled() {
+  return _parent->dimensions[_id]->scale != NULL && _parent->dimensions[_id]->scale->steps > 0;
+}
+
+bool Dimension::isSubscribed() {
+  return _parent->isSubscribed(_id);
+}
+
+void Dimension::setOnDemand(bool onDemand) {
+  _parent->setSubscribed(_id, !onDemand);
+}
@@ -15,6 +15,62 @@ Distributed "as is" under the MIT License. See LICENSE.md for details.
 #define __TELEMETRYJET_H__
 
 #include <Arduino.h>
+#include "TelemetryJetConfig.h"
+
+// Frame size limits, in bytes.
+// A frame is everything written between two packet frame markers: checksum, flag byte,
+// the COBS-encoded MessagePack records, and the trailing 0x0 frame marker.
+// The default size is used when no size is passed to the TelemetryJet constructor.
+// Boards with more RAM default to larger frames, so more records share a single frame header.
+// Define TELEMETRYJET_DEFAULT_FRAME_SIZE before including this header to override the default.
+#define TELEMETRYJET_MIN_FRAME_SIZE 24
+#define TELEMETRYJET_MAX_FRAME_SIZE 1024
+#ifndef TELEMETRYJET_DEFAULT_FRAME_SIZE
+#if defined(__AVR__)
+#define TELEMETRYJET_DEFAULT_FRAME_SIZE 32
+#else
+#define TELEMETRYJET_DEFAULT_FRAME_SIZE 256
+#endif
+#endif
+
+// Text mode number formatting
+// Floats are written with a fixed number of decimals. Every formatted value, including a 64-bit integer
+// and its sign, fits in TELEMETRYJET_TEXT_MAX_VALUE_LENGTH characters, and every key:value prefix
+// (including an array index) in TELEMETRYJET_TEXT_MAX_KEY_LENGTH.
+#ifndef TELEMETRYJET_TEXT_DECIMALS
+#define TELEMETRYJET_TEXT_DECIMALS 2
+#endif
+#define TELEMETRYJET_TEXT_MAX_VALUE_LENGTH 22
+#define TELEMETRYJET_TEXT_MAX_KEY_LENGTH 10
+
+// Frame sequence numbers count from 1 up to this value, then wrap back to 1
+#define TELEMETRYJET_MAX_SEQUENCE 63
+
+// Adaptive transmit rate
+// Each decimation level halves the rate of dimensions whose priority is below that level.
+// Congestion is detected when writes block for more than 1/4 of the transmit interval,
+// or when the received frame loss rate goes above the threshold.
+#define TELEMETRYJET_MAX_DECIMATION_LEVEL 6
+#define TELEMETRYJET_ADAPTIVE_RECOVERY_TICKS 8
+#define TELEMETRYJET_ADAPTIVE_LOSS_THRESHOLD 0.1
+
+// Snapshot reads
+// Number of times Dimension::getSnapshot() tries again while the value is being written, before giving up
+#define TELEMETRYJET_SNAPSHOT_RETRIES 64
+
+// Reliable delivery
+// Number of unacknowledged reliable frames a sender can have in flight,
+// and the default time before they are sent again.
+#define TELEMETRYJET_RELIABLE_WINDOW 4
+#define TELEMETRYJET_RELIABLE_TIMEOUT 250
+
+// Memory barrier between an interrupt handler publishing values and update() reading them
+// AVR is single-core, so only the compiler needs to keep memory accesses in order.
+#if defined(__AVR__)
+#define TELEMETRYJET_MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define TELEMETRYJET_MEMORY_BARRIER() __sync_synchronize()
+#endif
 
 /*
 DataPointType
@@ -31,9 +87,68 @@ enum class DataPointType : int {
     INT32,
     INT64,
     FLOAT32,
+    FLOAT16,
     NUM_TYPES
 };
 
+// Array records
+// A record whose type has this bit set holds a MessagePack array of values,
+// all of the DataPointType in the lower bits, in place of a single value.
+#define TELEMETRYJET_ARRAY_TYPE_FLAG 0x40
+#define TELEMETRYJET_MAX_ARRAY_LENGTH 255
+
+// Waveform block records
+// A record of this type carries part of a block of waveform samples, see Waveform.
+// Value: MessagePack array of [block sequence, sample rate (Hz), block start time (us), offset of the first sample
+// in the block, samples as little-endian int16 binary].
+#define TELEMETRYJET_BLOCK_TYPE 0x20
+
+// Scaled value records
+// FLOAT32 values of a dimension with a scale (see Dimension::setScale) are sent as an unsigned number of steps.
+// Scale record value: MessagePack array of [minimum, resolution], as 32-bit floats.
+// Scaled value record value: unsigned integer n, for the value minimum + n * resolution.
+// The scale record is sent with the first scaled value, and again with every TELEMETRYJET_SCALE_INTERVAL values.
+#define TELEMETRYJET_SCALE_TYPE 0x21
+#define TELEMETRYJET_SCALED_VALUE_TYPE 0x22
+#define TELEMETRYJET_SCALE_INTERVAL 32
+
+/*
+ControlType
+Record types reserved for protocol control records.
+Control records share the (key, type, value) layout of data point records, with an unsigned integer value.
+Their IDs start at TELEMETRYJET_CONTROL_TYPE_BASE, so they never collide with a DataPointType.
+*/
+#define TELEMETRYJET_CONTROL_TYPE_BASE 0x80
+enum class ControlType : uint8_t {
+    // Starts a reliable frame. Key: reliable sequence number. Value: 1 until the sender receives its first ACK.
+    RELIABLE = 0x80,
+    // Acknowledges reliable frames. Key: last reliable sequence number received in order. Value: unused.
+    ACK = 0x81,
+    // Sent by the host to choose which dimensions are streamed. Key: first key of a range. Value: last key, inclusive.
+    SUBSCRIBE = 0x82,
+    UNSUBSCRIBE = 0x83,
+    // Sent by the host to slow down a dimension. Key: dimension key. Value: minimum interval in ms (0 = every tick).
+    SET_RATE = 0x84,
+    // Sent by the host to read values on demand. Key: first key of a range. Value: last key, inclusive.
+    // The values are sent back together at the next update(), whether or not they are subscribed.
+    READ = 0x85,
+    // Sent by a bus master at the start of each slot cycle. Key: number of node slots. Value: slot length in ms.
+    BUS_SYNC = 0x86,
+    // Sent by a bus master to let one node transmit. Key: node address. Value: unused.
+    BUS_POLL = 0x87
+};
+
+// Bus mode: frames carry one address byte after the flag byte, see TelemetryJet::setBusNode
+// Nodes use addresses 1 to TELEMETRYJET_BUS_MAX_ADDRESS. Frames from the master set TELEMETRYJET_BUS_MASTER_FLAG,
+// and are addressed to TELEMETRYJET_BUS_BROADCAST (every node), or to a single node for the ACKs of its reliable frames.
+#define TELEMETRYJET_BUS_MAX_ADDRESS 126
+#define TELEMETRYJET_BUS_BROADCAST 0x7F
+#define TELEMETRYJET_BUS_MASTER_FLAG 0x80
+// In the SLOTTED schedule, a device only starts a frame that ends this many ms before its slot does, at the bus
+// baud rate (see TelemetryJet::setBusBaudRate). The guard time also covers the 1 ms resolution of millis().
+#define TELEMETRYJET_BUS_BAUD_RATE 115200
+#define TELEMETRYJET_BUS_GUARD_TIME 2
+
 /*
 DataPointValue
 Container for typed data point values.
@@ -43,12 +158,154 @@ union DataPointValue {
   uint8_t v_uint8;
   uint16_t v_uint16;
   uint32_t v_uint32;
+#if TELEMETRYJET_64BIT_TYPES
   uint64_t v_uint64;
+#endif
   int8_t v_int8;
   int16_t v_int16;
   int32_t v_int32;
+#if TELEMETRYJET_64BIT_TYPES
   int64_t v_int64;
+#endif
   float v_float32;
+  // IEEE 754 half precision bits
+  uint16_t v_float16;
+};
+
+/*
+Type compatibility
+Bitmask of the stored types that a getter for the requested type can return, by converting UP.
+Evaluated at compile time for typed dimensions, and with a single mask test for untyped ones.
+*/
+#define TELEMETRYJET_TYPE_BIT(type) (1 << (int)DataPointType::type)
+constexpr uint16_t compatibleTypes(DataPointType requested) {
+  return
+    requested == DataPointType::BOOLEAN ? TELEMETRYJET_TYPE_BIT(BOOLEAN) :
+    requested == DataPointType::UINT8   ? TELEMETRYJET_TYPE_BIT(BOOLEAN) | TELEMETRYJET_TYPE_BIT(UINT8) :
+    requested == DataPointType::UINT16  ? compatibleTypes(DataPointType::UINT8)  | TELEMETRYJET_TYPE_BIT(UINT16) :
+    requested == DataPointType::UINT32  ? compatibleTypes(DataPointType::UINT16) | TELEMETRYJET_TYPE_BIT(UINT32) :
+    requested == DataPointType::UINT64  ? compatibleTypes(DataPointType::UINT32) | TELEMETRYJET_TYPE_BIT(UINT64) :
+    requested == DataPointType::INT8    ? TELEMETRYJET_TYPE_BIT(BOOLEAN) | TELEMETRYJET_TYPE_BIT(INT8) :
+    requested == DataPointType::INT16   ? compatibleTypes(DataPointType::INT8)   | TELEMETRYJET_TYPE_BIT(INT16) :
+    requested == DataPointType::INT32   ? compatibleTypes(DataPointType::INT16)  | TELEMETRYJET_TYPE_BIT(INT32) :
+    requested == DataPointType::INT64   ? compatibleTypes(DataPointType::INT32)  | TELEMETRYJET_TYPE_BIT(INT64) :
+    requested == DataPointType::FLOAT16 ? TELEMETRYJET_TYPE_BIT(FLOAT16) :
+    requested == DataPointType::FLOAT32 ? TELEMETRYJET_TYPE_BIT(FLOAT16) | TELEMETRYJET_TYPE_BIT(FLOAT32) :
+    0;
+}
+
+constexpr bool isCompatibleType(DataPointType stored, DataPointType requested) {
+  return (compatibleTypes(requested) >> (int)stored) & 1;
+}
+
+/*
+DataPointTraits
+Maps each C++ value type to its DataPointType and its member of DataPointValue.
+Used by TypedDimension<T>, so the type is resolved at compile time.
+*/
+template <typename T> struct DataPointTraits;
+
+#define TELEMETRYJET_DATAPOINT_TRAITS(valueType, pointType, member) \
+  template <> struct DataPointTraits<valueType> { \
+    static constexpr DataPointType type = DataPointType::pointType; \
+    static valueType load(const DataPointValue& value) { return value.member; } \
+    static void store(DataPointValue& value, valueType v) { value.member = v; } \
+  };
+
+TELEMETRYJET_DATAPOINT_TRAITS(bool,     BOOLEAN, v_bool)
+TELEMETRYJET_DATAPOINT_TRAITS(uint8_t,  UINT8,   v_uint8)
+TELEMETRYJET_DATAPOINT_TRAITS(uint16_t, UINT16,  v_uint16)
+TELEMETRYJET_DATAPOINT_TRAITS(uint32_t, UINT32,  v_uint32)
+TELEMETRYJET_DATAPOINT_TRAITS(int8_t,   INT8,    v_int8)
+TELEMETRYJET_DATAPOINT_TRAITS(int16_t,  INT16,   v_int16)
+TELEMETRYJET_DATAPOINT_TRAITS(int32_t,  INT32,   v_int32)
+TELEMETRYJET_DATAPOINT_TRAITS(float,    FLOAT32, v_float32)
+#if TELEMETRYJET_64BIT_TYPES
+TELEMETRYJET_DATAPOINT_TRAITS(uint64_t, UINT64,  v_uint64)
+TELEMETRYJET_DATAPOINT_TRAITS(int64_t,  INT64,   v_int64)
+#endif
+
+/*
+DataPointBinding
+Where a bound dimension reads its value from, instead of being set: a variable, or a sampler function returning the value.
+*/
+enum class DataPointBinding : uint8_t {
+    NONE,
+    VARIABLE,
+    SAMPLER
+};
+
+union DataPointSource {
+  void* variable;
+  void (*sampler)();
+};
+
+/*
+TextFormat
+Layout of the lines printed in text mode.
+COLUMNS: one column per dimension, in the order they were created, with 0 for dimensions without a value.
+KEY_VALUE: key:value pairs, only for the dimensions with a new value in delta mode, so lines scale with the change rate.
+*/
+enum class TextFormat : uint8_t {
+    COLUMNS,
+    KEY_VALUE
+};
+
+/*
+TransportMode
+What an additional transport (see TelemetryJet::addTransport) receives.
+BINARY: the same frames as the main transport, encoded once. Frames received on it are read like those of the main transport.
+TEXT: a text line with every value at its own rate, as printed in text mode.
+CAN: values as CAN frames through a CanDriver, see TelemetryJet::addTransport(CanDriver*, ...).
+*/
+enum class TransportMode : uint8_t {
+    BINARY,
+    TEXT,
+    CAN
+};
+
+/*
+BusSchedule
+How devices sharing a half-duplex bus take turns, see TelemetryJet::setBusNode.
+SLOTTED: the master starts a cycle of time slots with a sync record; node N transmits only during slot N.
+POLLED: the master polls nodes in turn; a node transmits only right after it is polled.
+*/
+enum class BusSchedule : uint8_t {
+    SLOTTED,
+    POLLED
+};
+
+/*
+ReceiveEvent
+A value received from the host, as stored in the receive queue.
+The type and value are exactly as sent, before any conversion for typed or bound dimensions.
+An event holds a single value, so array records are not queued; read them from their dimension.
+*/
+struct ReceiveEvent {
+  uint16_t key;
+  DataPointType type;
+  DataPointValue value;
+  uint32_t timestamp;
+};
+
+/*
+ReceiveCallback
+Called from update() when a value for a dimension is received from the host.
+*/
+class Dimension;
+typedef void (*ReceiveCallback)(Dimension dimension);
+
+/*
+DataPointScale
+Scaled encoding of a dimension (see Dimension::setScale), only allocated for dimensions that have a scale.
+FLOAT32 values are sent as steps of 'resolution' above 'minimum'.
+Values are only sent scaled when steps > 0; a scale learned from a received scale record is only used to decode.
+*/
+struct DataPointScale {
+  float minimum;
+  float resolution;
+  uint32_t steps;
+  uint8_t announceCountdown;
 };
 
 /*
@@ -64,11 +321,85 @@ struct DataPoint {
   bool hasNewReceivedValue = false;
   bool hasNewTransmitValue = false;
   bool hasTimeout = false;
+  bool isUrgent = false;
+  bool isReliable = false;
+  bool hasReadRequest = false;
+  bool hasFixedType = false;
+  DataPointBinding binding = DataPointBinding::NONE;
+  DataPointSource source;
+#if TELEMETRYJET_RX
+  ReceiveCallback receiveCallback = NULL;
+#endif
+  uint8_t priority = 0;
+  uint8_t rateDivisor = 1;
   uint32_t timeoutInterval = 0;
   uint32_t lastTimestamp = 0;
+  // Array values, when arrayLength > 0: arrayLength values of 'type', in arrayValues
+  // The storage grows as needed, and is kept when the dimension goes back to a single value.
+  uint8_t arrayLength = 0;
+  uint16_t arrayCapacity = 0;
+  void* arrayValues = NULL;
+  // Scaled encoding, or NULL for dimensions without a scale
+  DataPointScale* scale = NULL;
+  // Sequence lock for snapshot reads: odd while the type, value, timestamp or hasValue flag are being written
+  volatile uint8_t version = 0;
+};
+
+/*
+DataPointSnapshot
+A consistent copy of a data point's value, read with Dimension::getSnapshot().
+*/
+struct DataPointSnapshot {
+  DataPointType type;
+  DataPointValue value;
+  uint32_t timestamp;
+  bool hasValue;
+};
+
+/*
+LinkStatistics
+Counters describing the quality of the binary link, in both directions.
+Frames carry a rolling sequence number, so frames lost or reordered on the way in can be counted.
+*/
+struct LinkStatistics {
+  // Frames and bytes written to the transport
+  uint32_t txFrames = 0;
+  uint32_t txBytes = 0;
+  // Records that were too large to fit in an empty frame
+  uint32_t txDroppedRecords = 0;
+
+  // Valid frames and total bytes read from the transport
+  uint32_t rxFrames = 0;
+  uint32_t rxBytes = 0;
+  // Frames dropped on arrival, by cause
+  uint32_t rxDroppedChecksum = 0;
+  uint32_t rxDroppedOverflow = 0;
+  uint32_t rxDroppedDecode = 0;
+  // Valid frames forwarded to another transport by a route, without being read
+  uint32_t rxForwardedFrames = 0;
+  // Gaps, late arrivals and repeats in the senders' sequence numbers, summed over every transport
+  // (see TelemetryJet::getReceiveStatistics for each transport on its own)
+  uint32_t rxLostFrames = 0;
+  uint32_t rxReorderedFrames = 0;
+  uint32_t rxDuplicateFrames = 0;
+  // Reliable frames sent again after a timeout, and received reliable frames skipped as repeats or out of order
+  uint32_t txRetransmittedFrames = 0;
+  uint32_t rxReliableDiscarded = 0;
+  // Received values dropped because the receive queue was full
+  uint32_t rxQueueOverflows = 0;
+  // Values published from interrupt handlers that were dropped because the publish ring was full
+  // (exact as long as update() runs before 256 values are dropped)
+  uint32_t publishOverflows = 0;
+  // Waveform blocks and bytes sent, and blocks dropped because the previous block had not been sent yet
+  uint32_t txWaveformBlocks = 0;
+  uint32_t txWaveformBytes = 0;
+  uint32_t txWaveformDroppedBlocks = 0;
+  // Recent fraction of frames lost (0.0 - 1.0), as a moving average over roughly the last 16 frames
+  float rxLossRate = 0.0;
 };
 
 class TelemetryJet;
+template <typename T> class TypedDimension;
 
 /*
 Dimension
@@ -81,6 +412,14 @@ class Dimension {
   uint16_t _id;
   TelemetryJet* _parent;
   Dimension(uint16_t id, TelemetryJet* parent) : _id(id), _parent(parent) {};
+  void updateValue(DataPointType type, const DataPointValue& value);
+  void updateArray(DataPointType type, const void* values, uint8_t length);
+  void updateFlags(DataPoint* point);
+  uint8_t getArrayValues(DataPointType type, void* values, uint8_t maxLength);
+  template <typename T> void setValue(T value);
+  template <typename T> T getValue(T defaultValue);
+  bool hasType(DataPointType type, bool exact);
+  void bindSource(DataPointType type, DataPointBinding binding, DataPointSource source);
  public:
   // Write a typed value to this dimension
   // Setting a value will record the value, type, and timestamp.
@@ -89,12 +428,16 @@ class Dimension {
   void setUInt8  (uint8_t value);
   void setUInt16 (uint16_t value);
   void setUInt32 (uint32_t value);
-  void setUInt64 (uint64_t value);
   void setInt8   (int8_t value);
   void setInt16  (int16_t value);
   void setInt32  (int32_t value);
-  void setInt64  (int64_t value);
   void setFloat32(float value);
+  // Stored and sent as a half precision float: about 3 significant digits, up to +/-65504
+  void setFloat16(float value);
+#if TELEMETRYJET_64BIT_TYPES
+  void setUInt64 (uint64_t value);
+  void setInt64  (int64_t value);
+#endif
   
   // Get a typed value from this dimension
   // If a value is not available, returns the default
@@ -120,18 +463,31 @@ class Dimension {
   // - int32  -> getInt32, getInt64
   // - int64  -> getInt64
   // Floating point family:
+  // - float16 -> getFloat16, getFloat32
   // - float32 -> getFloat32
   bool     getBool   (bool     defaultValue = false);
   uint8_t  getUInt8  (uint8_t  defaultValue = 0);
   uint16_t getUInt16 (uint16_t defaultValue = 0);
   uint32_t getUInt32 (uint32_t defaultValue = 0);
-  uint64_t getUInt64 (uint64_t defaultValue = 0);
   int8_t   getInt8   (int8_t   defaultValue = 0);
   int16_t  getInt16  (int16_t  defaultValue = 0);
   int32_t  getInt32  (int32_t  defaultValue = 0);
-  int64_t  getInt64  (int64_t  defaultValue = 0);
   float    getFloat32(float    defaultValue = 0.0);
+  float    getFloat16(float    defaultValue = 0.0);
+#if TELEMETRYJET_64BIT_TYPES
+  uint64_t getUInt64 (uint64_t defaultValue = 0);
+  int64_t  getInt64  (int64_t  defaultValue = 0);
+#endif
   
+  // Arrays: write or read a fixed number of values of one type, sent together in a single record
+  // Useful for multi-axis sensors or groups of channels, such as the cells of a battery pack.
+  // getArray() converts values UP like the getters above, copies at most maxLength values,
+  // and returns the number copied (0 if no compatible array is available).
+  template <typename T> void setArray(const T* values, uint8_t length);
+  template <typename T> uint8_t getArray(T* values, uint8_t maxLength);
+  // Number of values in the stored array, or 0 if a single value is stored
+  uint8_t getArrayLength();
+
   // Value checks: Return whether a value is present
   // 'exact' parameter determines whether we must have a value of exactly this type,
   // or can also have a compatible value as described in the Getters section.
@@ -141,36 +497,362 @@ class Dimension {
   bool hasUInt8  (bool exact = false);
   bool hasUInt16 (bool exact = false);
   bool hasUInt32 (bool exact = false);
-  bool hasUInt64 (bool exact = false);
   bool hasInt8   (bool exact = false);
   bool hasInt16  (bool exact = false);
   bool hasInt32  (bool exact = false);
-  bool hasInt64  (bool exact = false);
   bool hasFloat32(bool exact = false);
+  bool hasFloat16(bool exact = false);
+#if TELEMETRYJET_64BIT_TYPES
+  bool hasUInt64 (bool exact = false);
+  bool hasInt64  (bool exact = false);
+#endif
 
   // Clear a value if it is present
   void clearValue();
 
-  // Metadata and flags: Value type, timeout age
+  // Read a consistent copy of the value, type and timestamp from another core, task or interrupt handler
+  // The getters are meant for the code that calls update(); a value they read can be torn if it is written
+  // at the same time from elsewhere. getSnapshot() retries while a write is in progress, without taking a lock.
+  // Returns false if the value kept changing, or the write was interrupted by the caller itself;
+  // try again later in that case.
+  bool getSnapshot(DataPointSnapshot* snapshot);
+
+  // Metadata and flags: Key, value type, timeout age
+  uint16_t getKey();
   DataPointType getType();
   int32_t getTimeoutAge();
   int32_t getCurrentAge();
   void setTimeoutAge(uint32_t timeoutAge = 0);
   bool hasNewValue();
 
+  // Transmit priority, used when adaptive rate is enabled
+  // Dimensions with the lowest priority (0, the default) are slowed down first as the link degrades.
+  // A priority of TELEMETRYJET_MAX_DECIMATION_LEVEL or more is never slowed down.
+  void setPriority(uint8_t priority);
+  uint8_t getPriority();
+
+  // Urgent dimensions skip the transmit interval
+  // A value written to an urgent dimension is sent on the very next call to update(),
+  // in its own frame, instead of waiting for the next transmit tick.
+  // Urgent values are never slowed down by the adaptive rate.
+  void setUrgent(bool urgent = true);
+  bool isUrgent();
+
+  // Reliable dimensions are delivered with acknowledgement and retransmission
+  // New values are sent in numbered frames, which are repeated until the receiver acknowledges them.
+  // Reliable values are only sent when they change, even when delta mode is off.
+  // Returns false, and leaves the dimension unreliable, if the retransmit window can't be allocated.
+#if TELEMETRYJET_RX
+  bool setReliable(bool reliable = true);
+#endif
+  bool isReliable();
+
+  // Whether the host currently wants this dimension streamed
+  // The host can unsubscribe dimensions with control records; values written meanwhile are kept, but not sent.
+  bool isSubscribed();
+
+  // On-demand dimensions are not streamed
+  // The value is only sent when the host reads it, or after the host subscribes to it.
+  void setOnDemand(bool onDemand = true);
+
+  // Scaled encoding for float values with a known range and resolution
+  // FLOAT32 values are sent as the number of steps of 'resolution' above 'minimum', clamped to the range, in the
+  // smallest integer that holds the whole range (for example 0-60V at 0.01V fits 16 bits). The receiver turns
+  // them back into floats; getFloat32() on this side keeps returning the full precision value.
+  // Steps are computed with 32-bit floats, which hold whole numbers exactly only up to 2^24: with more steps than
+  // that, values are rounded to a coarser step than 'resolution'.
+  // Returns false, and leaves the dimension unscaled, if the range doesn't fit in 32 bits of steps, or if the scale
+  // could not be allocated.
+  bool setScale(float minimum, float maximum, float resolution);
+  void clearScale();
+  bool isScaled();
+
+  // Bind this dimension to a variable, or to a sampler function returning its value
+  // Bound dimensions are read only when their value is about to be sent (on transmit ticks and host reads),
+  // so the cost scales with the transmit rate instead of the loop rate. Values received from the host
+  // are written straight into a bound variable, converted UP to its type if needed.
+  // Binding fixes the type of the dimension to T, as in a TypedDimension: values of other types, from the host or
+  // from setters, are converted UP to T or dropped, and arrays are dropped. The type stays fixed after unbind().
+  template <typename T> void bind(T* variable);
+  template <typename T> void bind(T (*sampler)());
+  void unbind();
+
+  // Write a value from an interrupt handler
+  // The value is queued in a lock-free ring buffer, and stored by the next update(), with the time it was published.
+  // Enable the ring with TelemetryJet::setPublishQueueSize() first. Only one interrupt handler may publish
+  // to an instance, and the regular setters must not be used for the same dimension.
+  // Returns false if the ring is disabled or full; dropped values are counted in LinkStatistics::publishOverflows.
+  template <typename T> bool publish(T value);
+
+  friend class TelemetryJet;
+  template <typename T> friend class TypedDimension;
+};
+
+template <typename T>
+void Dimension::setValue(T value) {
+  DataPointValue newValue;
+  DataPointTraits<T>::store(newValue, value);
+  updateValue(DataPointTraits<T>::type, newValue);
+}
+
+template <typename T>
+void Dimension::setArray(const T* values, uint8_t length) {
+  updateArray(DataPointTraits<T>::type, values, length);
+}
+
+template <typename T>
+uint8_t Dimension::getArray(T* values, uint8_t maxLength) {
+  return getArrayValues(DataPointTraits<T>::type, values, maxLength);
+}
+
+template <typename T>
+void Dimension::bind(T* variable) {
+  DataPointSource source;
+  source.variable = variable;
+  bindSource(DataPointTraits<T>::type, DataPointBinding::VARIABLE, source);
+}
+
+template <typename T>
+void Dimension::bind(T (*sampler)()) {
+  DataPointSource source;
+  source.sampler = reinterpret_cast<void (*)()>(sampler);
+  bindSource(DataPointTraits<T>::type, DataPointBinding::SAMPLER, source);
+}
+
+/*
+WaveformChannel
+Double-buffered sample blocks for one waveform.
+Samples are pushed into one block while the other one is sent. The pushing side only writes fillIndex, fillBlock,
+nextSequence and droppedBlocks, and hands a full block over by setting isBlockReady; update() only clears it.
+*/
+struct WaveformChannel {
+  uint16_t key;
+  uint16_t blockSize;
+  uint32_t sampleRate;
+  int16_t* samples;
+  volatile uint16_t fillIndex;
+  volatile uint8_t fillBlock;
+  volatile bool isBlockReady[2];
+  uint32_t blockStart[2];
+  uint16_t blockSequence[2];
+  uint16_t nextSequence;
+  volatile uint8_t droppedBlocks;
+  uint8_t droppedBlocksCounted;
+  uint16_t sendOffset;
+};
+
+/*
+Waveform
+A stream of samples at a fixed rate, such as an ADC capturing a motor current.
+Samples are collected in blocks, and each full block is sent in one or more frames, between regular telemetry.
+Like Dimension, this wrapper holds no data and can be passed by value.
+*/
+class Waveform {
+ private:
+  uint8_t _id;
+  TelemetryJet* _parent;
+  Waveform(uint8_t id, TelemetryJet* parent) : _id(id), _parent(parent) {};
+ public:
+  // Add a sample; safe to call from one interrupt handler
+  // Returns false if the block it completed had to be dropped, because the previous block has not been sent yet.
+  bool push(int16_t sample);
+  // False if createWaveform could not allocate the channel; push() then does nothing
+  bool isValid();
+  uint16_t getBlockSize();
+  uint32_t getSampleRate();
+
   friend class TelemetryJet;
 };
 
+#if TELEMETRYJET_RX
+/*
+ReceiveStatistics
+Frame and loss counters for the frames received on one transport, see TelemetryJet::getReceiveStatistics.
+*/
+struct ReceiveStatistics {
+  uint32_t rxFrames;
+  uint32_t rxLostFrames;
+  uint32_t rxReorderedFrames;
+  uint32_t rxDuplicateFrames;
+  // Recent fraction of frames lost (0.0 - 1.0), as a moving average over roughly the last 16 frames
+  float rxLossRate;
+};
+
+/*
+ReceiveState
+What an instance tracks about the frames from one sender: the sequence number of the last one, for the loss
+counters, and the next reliable frame expected. Every sender numbers its frames separately, so each transport
+keeps its own. All zero before the first frame.
+*/
+struct ReceiveState {
+  uint8_t rxSequence;
+  bool hasReliableRxSequence;
+  bool hasReliableAck;
+  uint16_t reliableRxExpected;
+  ReceiveStatistics statistics;
+};
+#endif
+
+/*
+CanDriver
+Interface to a CAN controller, implemented by the sketch over the controller's own library.
+TelemetryJet only calls it from update(). IDs above 0x7FF should be sent as extended (29-bit) IDs.
+*/
+class CanDriver {
+ public:
+  // Queue a frame of up to 8 data bytes. Returns false if it can't be queued.
+  virtual bool write(uint32_t id, const uint8_t* data, uint8_t length) = 0;
+  // Take the next received frame into 'data' (8 bytes). Returns false if no frame is waiting.
+  virtual bool read(uint32_t* id, uint8_t* data, uint8_t* length) = 0;
+};
+
+/*
+TransportChannel
+An additional transport served by an instance, with its own receive buffer for binary and CAN transports.
+CAN transports reassemble segmented batches in the receive buffer, and have no stream. The CAN bus of an instance
+without a main stream is served as a channel too.
+*/
+struct TransportChannel {
+  Stream* stream;
+  CanDriver* can;
+  TransportMode mode;
+  unsigned long textRate;
+  unsigned long lastSent;
+  uint32_t canBaseId;
+  uint32_t canTxBatchId;
+  uint32_t canRxBatchId;
+  uint8_t* rxBuffer;
+  uint16_t rxIndex;
+  uint16_t rxBatchLength;
+  uint8_t rxBatchSequence;
+  bool rxOverflow;
+#if TELEMETRYJET_RX
+  ReceiveState rxState;
+#endif
+};
+
+/*
+FrameRoute
+Forwards valid frames received on one transport to another, see TelemetryJet::addRoute.
+*/
+struct FrameRoute {
+  Stream* from;
+  Stream* to;
+  uint16_t firstKey;
+  uint16_t lastKey;
+};
+
 class TelemetryJet {
 private:
   Stream* transport;
   bool isInitialized = false;
   bool isTextMode = false;
   bool isDeltaMode = true;
+  TextFormat textFormat = TextFormat::COLUMNS;
+  uint16_t textFullLineInterval = 0;
+  uint16_t textLinesSinceFull = 0;
   bool hasBinaryWarningMessage = true;
+  bool hasUrgentValue = false;
+  bool hasReadRequest = false;
+
+  // Transactions: values set between beginTransaction() and commit() go out together
+  // Until commit(), the values are held here rather than in their data points, so nothing sends them early.
+  // Committed values stay listed, by commit, until they are written out as a group.
+  struct TransactionValue {
+    uint16_t id;
+    uint8_t commit;
+    bool isCommitted;
+    DataPointType type;
+    DataPointValue value;
+    uint8_t arrayLength;
+    void* arrayValues;
+  };
+  bool isInTransaction = false;
+  uint32_t transactionTimestamp = 0;
+  uint8_t commitCount = 0;
+  TransactionValue* transactionValues = NULL;
+  uint16_t numTransactionValues = 0;
+  uint16_t transactionCapacity = 0;
+
+  // Publish ring: values written by an interrupt handler, stored by update()
+  // Single producer, single consumer: the handler only writes publishHead and publishDropped,
+  // and update() only writes publishTail, so neither side needs to disable interrupts.
+  struct PublishedValue {
+    uint16_t id;
+    DataPointType type;
+    DataPointValue value;
+    uint32_t timestamp;
+  };
+  PublishedValue* publishQueue = NULL;
+  uint8_t publishQueueSlots = 0;
+  volatile uint8_t publishHead = 0;
+  volatile uint8_t publishTail = 0;
+  volatile uint8_t publishDropped = 0;
+  uint8_t publishDroppedCounted = 0;
+#if TELEMETRYJET_RX
+  ReceiveCallback receiveCallback = NULL;
+
+  // Receive queue: ring buffer of every value received, in order, when enabled
+  ReceiveEvent* rxQueue = NULL;
+  uint8_t rxQueueSize = 0;
+  uint8_t rxQueueHead = 0;
+  uint8_t rxQueueLength = 0;
+#endif
   uint32_t lastSent;
   uint32_t transmitRate;
 
+  // Adaptive transmit rate state
+  bool isAdaptiveRate = false;
+  uint8_t decimationLevel = 0;
+  uint8_t uncongestedTicks = 0;
+  uint16_t tickCount = 0;
+  uint32_t tickBytes = 0;
+  uint32_t tickWriteMicros = 0;
+  uint32_t effectiveRate = 0;
+
+  // Reliable delivery state
+  // Sent frames are kept in a window of TELEMETRYJET_RELIABLE_WINDOW payload slots until acknowledged.
+  bool hasReliableDimension = false;
+  uint8_t* reliableBuffer = NULL;
+#if TELEMETRYJET_RX
+  bool reliableTxSync = true;
+  uint16_t reliableSlotLength[TELEMETRYJET_RELIABLE_WINDOW];
+  uint32_t reliableSlotTimestamp[TELEMETRYJET_RELIABLE_WINDOW];
+  uint16_t reliableTxBase = 0;
+  uint16_t reliableTxNext = 0;
+  uint32_t reliableTimeout = TELEMETRYJET_RELIABLE_TIMEOUT;
+#endif
+
+#if TELEMETRYJET_RX
+  // Bus mode state
+  // Nodes learn the slot cycle from the master's sync records; busCycleStart is when the last one arrived.
+  // On the master, it is when the last cycle (slotted) or poll (polled) started.
+  enum class BusRole : uint8_t {
+    NONE,
+    NODE,
+    MASTER
+  };
+  BusRole busRole = BusRole::NONE;
+  BusSchedule busSchedule = BusSchedule::SLOTTED;
+  uint8_t busAddress = 0;
+  uint8_t busNumNodes = 0;
+  uint16_t busSlotLength = 0;
+  uint32_t busCycleStart = 0;
+  uint32_t busBaudRate = TELEMETRYJET_BUS_BAUD_RATE;
+  // Bytes this device may still send in its slot; 0xFFFF outside of the SLOTTED schedule
+  uint16_t busTurnBytes = 0xFFFF;
+  // micros() when the last byte this device wrote to the bus will have been sent
+  uint32_t busTxEnd = 0;
+  bool hasBusSync = false;
+  bool hasBusPoll = false;
+  bool isBusPollDue = false;
+  uint8_t busNextPoll = 1;
+  int busDirectionPin = -1;
+  // On the master, the receive state of each node, indexed by address - 1, since every node numbers its frames
+  // and reliable frames separately
+  ReceiveState* busNodeStates = NULL;
+#endif
+
   // Array of dimension values
   // Stores the latest data point for a dimension with a given ID
   // Starts with a slot of 8 items, and increases in chunks of 8 as more dimensions are created
@@ -178,19 +860,118 @@ private:
   uint16_t numDimensions = 0;
   uint16_t dimensionCacheLength = 8;
 
-  // Allocate fixed input, output, and temporary buffers
-  char tempBuffer[32];
-  char rxBuffer[32];
-  char txBuffer[32];
-  uint8_t rxIndex;
-  uint8_t txIndex;
-  uint32_t numDroppedRxPackets;
-  uint32_t numRxPackets;
-  uint32_t numTxPackets;
+  // Waveform channels, and the share of the link they may use
+  WaveformChannel** waveforms = NULL;
+  uint8_t numWaveforms = 0;
+  uint32_t waveformBudget = 0;
+  int32_t waveformCredit = 0;
+  uint32_t waveformCreditTime = 0;
+
+  // Additional transports, besides the main one
+  TransportChannel** transports = NULL;
+  uint8_t numTransports = 0;
+
+  // Gateway routes for received frames
+  FrameRoute* routes = NULL;
+  uint8_t numRoutes = 0;
+
+  // Host subscriptions, one bit per dimension
+  // Grows by one byte each time the dimension array grows by 8 slots.
+  uint8_t* subscriptions;
+
+  // Input, output, and temporary buffers
+  // Each buffer holds maxFrameSize bytes, allocated once in the constructor or setMaxFrameSize().
+  // tempBuffer accumulates MessagePack records for the next outgoing frame.
+  // Received frames are COBS-decoded in place inside rxBuffer.
+  uint8_t* tempBuffer;
+  uint8_t* rxBuffer;
+  uint8_t* txBuffer;
+  // Records of the outgoing frame that CAN transports send as a batch, allocated only while there are any
+  uint8_t* canBatch;
+  uint16_t canBatchLength = 0;
+  uint16_t maxFrameSize = 0;
+  uint16_t maxPayloadSize = 0;
+  uint16_t rxIndex = 0;
+  uint16_t txPayloadLength = 0;
+  bool rxOverflow = false;
+  uint8_t txSequence = 0;
+  LinkStatistics linkStatistics;
+#if TELEMETRYJET_RX
+  // Sequence and reliable delivery state of the main transport's sender
+  ReceiveState rxState = ReceiveState();
+#endif
 
   void updateHasValue(int id);
+  void sampleDimension(DataPoint* point);
+  bool publishValue(uint16_t id, DataPointType type, DataPointValue value);
+  void drainPublishQueue();
+  void holdTransactionValue(uint16_t id, DataPointType type, const DataPointValue& value, const void* arrayValues, uint8_t arrayLength);
+  bool storeTransactionValue(DataPoint* point, TransactionValue* entry);
+  uint16_t measureRecord(DataPoint* point);
+  uint16_t countCommittedValues();
+  void removeTransactionValues(uint16_t count);
+  bool isTransactionValue(uint16_t id, uint16_t count);
+  uint16_t writeTransaction();
+  void writeWaveforms();
+#if TELEMETRYJET_RX
+  void notifyReceived(uint16_t id);
+#endif
+  void initialize(uint16_t maxFrameSize);
+  bool allocateBuffers(uint16_t frameSize);
+  void removeTransportAt(uint8_t index);
+  bool addCanChannel(CanDriver* driver, uint32_t baseId, uint32_t txBatchId, uint32_t rxBatchId);
+#if TELEMETRYJET_TEXT_MODE
+  void updateTextMode();
+  void writeTextLine(Print* out, bool onlyChanged);
+  void writeTextTransports();
+#endif
+#if TELEMETRYJET_RX
+  void receiveFrames(Stream* stream, uint8_t* buffer, uint16_t& index, bool& overflow, ReceiveState* state);
+  void readFrame(Stream* from, uint8_t* frame, uint16_t length, ReceiveState* state);
+  void readPayload(const uint8_t* payload, size_t length, ReceiveState* state);
+  void receiveCanFrames(TransportChannel* channel);
+  void receiveCanSegment(TransportChannel* channel, const uint8_t* data, uint8_t length);
+  bool routeFrame(Stream* from, const uint8_t* frame, uint16_t length);
+  void writeRoutedFrame(Stream* from, Stream* to, const uint8_t* frame, uint16_t length);
+  void receiveRecord(uint16_t key, DataPointType type, DataPointValue value);
+  bool receiveControlRecord(uint16_t key, ControlType type, uint32_t value, ReceiveState* state);
+#endif
+  bool writeRecord(DataPoint* point);
+  void writeControlRecord(uint16_t key, ControlType type, uint32_t value);
+  void flushFrame();
+  void sendPayload(const uint8_t* payload, uint16_t payloadLength);
+  void writeFrame(const uint8_t* payload, uint16_t payloadLength);
+  void writeCanRecord(DataPoint* point, const uint8_t* record, uint16_t length);
+  void writeCanBatches(const uint8_t* batch, uint16_t length);
+  uint16_t encodeFrame(const uint8_t* payload, uint16_t payloadLength, uint8_t sequence, bool isOnBus, uint8_t busDestination = TELEMETRYJET_BUS_BROADCAST);
+  void writeMainTransport(const uint8_t* frame, uint16_t length);
+#if TELEMETRYJET_RX
+  void writeReliableFrames(bool urgentOnly);
+  void retransmitReliableFrames();
+  void writeAcks();
+  void sendAck(ReceiveState* state, TransportChannel* channel, uint8_t busAddress);
+  void updateRxSequence(ReceiveState* state, uint8_t sequence);
+  void updateLossRate(ReceiveState* state, bool lost);
+  bool beginBusTurn(bool& isPolled);
+  void endBusTurn();
+  uint16_t getBusTurnPayloadSize();
+  // Only the main transport is on the bus; frames on other transports have no address byte
+  bool isBusStream(Stream* stream) {
+    return busRole != BusRole::NONE && stream == transport;
+  }
+#endif
+  bool isDecimated(DataPoint* point);
+  void setSubscribed(uint16_t id, bool subscribed);
+  bool isSubscribed(uint16_t id) {
+    return subscriptions[id / 8] & (1 << (id % 8));
+  }
+  void updateAdaptiveRate(uint32_t elapsed);
 public:
-  TelemetryJet(Stream *transport, unsigned long transmitRate);
+  TelemetryJet(Stream *transport, unsigned long transmitRate, uint16_t maxFrameSize = TELEMETRYJET_DEFAULT_FRAME_SIZE);
+  // Serve a CAN bus as the main transport, with no stream at all; see addTransport(CanDriver*, ...)
+  // Text mode and bus mode need a stream, so the instance always sends binary data, and setBusNode and setBusMaster
+  // return false. Streams can still be added with addTransport.
+  TelemetryJet(CanDriver* driver, uint32_t baseId, uint32_t txBatchId, uint32_t rxBatchId, unsigned long transmitRate, uint16_t maxFrameSize = TELEMETRYJET_DEFAULT_FRAME_SIZE);
 
   // Update all data, handling any new inputs/outputs
   void update();
@@ -198,14 +979,136 @@ public:
   // Create a new dimension with a given key
   Dimension createDimension(uint16_t key, uint32_t timeoutAge = 0);
 
+  // Serve an additional transport, such as an SD card log next to a radio link
+  // Binary transports get the same frames as the main transport, encoded once, and stay silent while the
+  // instance is in text mode. Values and control records received on any binary transport are handled like
+  // those from the main transport. Text transports get a line with every value every textRate milliseconds,
+  // in the format set with setTextFormat().
+  // Returns false if the transport can't be added (out of memory, or text output compiled out).
+  bool addTransport(Stream* stream, TransportMode mode = TransportMode::BINARY, unsigned long textRate = 1000);
+  void removeTransport(Stream* stream);
+
+  // Serve a CAN bus, without COBS framing or checksums, since CAN frames every payload and checks its CRC
+  // Each value of up to 4 bytes is sent in its own CAN frame, with ID baseId + key, and the data bytes holding the
+  // value type and the raw value, little-endian; scaled values go as plain 32-bit floats. The other records of a
+  // frame (64-bit values, arrays, control records) are sent together as one batch, segmented ISO-TP style over CAN
+  // frames with ID txBatchId. Reliable frames and waveform chunks are sent whole, as batches.
+  // With TELEMETRYJET_RX, values received with IDs from baseId, and batches received with ID rxBatchId, are handled
+  // like those from the main transport. The two ends of a link swap their batch IDs; both must be outside of the
+  // IDs used for keys.
+  // Returns false if the transport can't be added (out of memory).
+  bool addTransport(CanDriver* driver, uint32_t baseId, uint32_t txBatchId, uint32_t rxBatchId);
+  void removeTransport(CanDriver* driver);
+
+#if TELEMETRYJET_RX
+  // Gateway routes: forward frames received on one transport to another, as they are
+  // A frame is forwarded when the key of its first record is in [firstKey, lastKey]. Only the frame marker and
+  // checksum are checked; the frame is neither decoded nor encoded again, so forwarding costs the same however
+  // many nodes sit behind the gateway. Frames that match a route are not read by this instance; frames starting
+  // with a control record (reliable delivery, subscriptions) only match routes over the full key range.
+  // 'from' is the main transport or a binary transport added with addTransport(); 'to' can be any stream.
+  bool addRoute(Stream* from, Stream* to, uint16_t firstKey = 0, uint16_t lastKey = 0xFFFF);
+  void clearRoutes();
+
+  // Bus mode, for several devices sharing one half-duplex link such as RS-485
+  // Every frame carries the address of the node that sent it, and devices only transmit in their turn, as set by
+  // the master (see BusSchedule). Values set outside of this device's turn stay pending until the next one.
+  // setBusNode: join the bus as node 'address' (1 to TELEMETRYJET_BUS_MAX_ADDRESS). Nodes stay silent until they
+  // hear the master, and only read frames from the master.
+  // setBusMaster: run the bus with nodes 1 to numNodes. In the SLOTTED schedule, the master owns slot 0 and each
+  // node gets one slot of slotLength ms per cycle. In the POLLED schedule, the master polls one node every
+  // slotLength ms, which must leave the node enough time to answer. The master reads the frames from every node.
+  // Each device on the bus must be in bus mode, and use the same schedule. Frames are one byte longer than usual,
+  // on the main transport only: additional transports and routes to them carry the usual frames.
+  // Returns false if the address or the node count is out of range, or the buffers can't be allocated.
+  bool setBusNode(uint8_t address, BusSchedule schedule = BusSchedule::SLOTTED);
+  bool setBusMaster(BusSchedule schedule, uint8_t numNodes, uint16_t slotLength);
+  // Drive a transceiver's driver-enable pin: HIGH while this device transmits, LOW otherwise
+  // The pin is set LOW again only after the transport's flush() returns, once every byte has left.
+  void setBusDirectionPin(int pin);
+  // Baud rate of the bus, for the SLOTTED schedule: frames that would not end TELEMETRYJET_BUS_GUARD_TIME ms before
+  // the end of this device's slot are held for its next slot
+  void setBusBaudRate(uint32_t baudRate = TELEMETRYJET_BUS_BAUD_RATE) {
+    busBaudRate = (baudRate >= 300) ? baudRate : 300;
+  }
+#endif
+
+  // Create a waveform channel with a given key
+  // Samples are sent in blocks of blockSize samples; two blocks are allocated.
+  // Larger frames (see setMaxFrameSize) carry more samples per frame, with less overhead.
+  // If the blocks can't be allocated, or 255 waveforms exist already, the returned waveform is not valid.
+  Waveform createWaveform(uint16_t key, uint32_t sampleRate, uint16_t blockSize);
+
+  // Link budget for waveforms, in bytes per second (0, the default, is unlimited)
+  // Waveform blocks are held back while they would go over the budget, leaving the rest of the link
+  // for regular telemetry. Blocks that can't be sent in time are dropped and counted in the link statistics.
+  void setWaveformBudget(uint32_t bytesPerSecond) {
+    waveformBudget = bytesPerSecond;
+  }
+
+  // Transactions
+  // Values set between beginTransaction() and commit() share one timestamp, and are sent together in the same
+  // frame at the next transmit tick (or right away, if one of them is urgent). Until commit(), the dimensions keep
+  // their committed values: getters, text lines and replies to the host all see the values from before the transaction.
+  // commit() returns false if the values can't fit in a single frame; they are then sent in consecutive frames.
+  // Reliable values in a transaction are sent through the reliable window, separately from the others.
+  void beginTransaction();
+  bool commit();
+
+  // Publish ring for values written from an interrupt handler with Dimension::publish()
+  // Holds up to 'size' values between two calls to update(). A size of 0 (the default) disables it.
+  // Must not be called while an interrupt handler may be publishing. Returns false if the ring could not be allocated.
+  bool setPublishQueueSize(uint8_t size);
+
+  // Create a new dimension with a value type fixed at compile time, for example createDimension<float>(1)
+  template <typename T> TypedDimension<T> createDimension(uint16_t key, uint32_t timeoutAge = 0);
+
   // Get the number of dimensions
   uint16_t getNumDimensions() {
     return numDimensions;
   }
 
+#if TELEMETRYJET_RX
+  // Register a function to call when the host sends a value for a key, instead of polling hasNewValue()
+  // The callback runs inside update(), as soon as the value is decoded, and receives the updated dimension.
+  // Returns false if no dimension has been created with this key. Pass NULL to remove the callback.
+  bool onReceive(uint16_t key, ReceiveCallback callback);
+
+  // Register a function to call when the host sends a value for any key
+  // It runs after the callback for the key itself, if there is one.
+  void onReceive(ReceiveCallback callback) {
+    receiveCallback = callback;
+  }
+
+  // Receive queue
+  // Dimensions only keep the latest value, so values received for the same key between two loops overwrite each other.
+  // When the queue is enabled, every value received is also queued in order, including keys with no dimension,
+  // and can be read back one at a time. Arrays are not queued, and never count as overflows; only the latest array
+  // of each dimension is kept, as without the queue. When the queue is full, new values are dropped and counted in
+  // LinkStatistics::rxQueueOverflows. A size of 0 (the default) disables the queue.
+  // Returns false if the queue could not be allocated.
+  bool setReceiveQueueSize(uint8_t size);
+  // Take the oldest value from the queue. Returns false if the queue is empty.
+  bool readReceiveEvent(ReceiveEvent* event);
+  uint8_t getReceiveQueueLength() {
+    return rxQueueLength;
+  }
+#endif
+
+#if TELEMETRYJET_TEXT_MODE
   void setTextMode(bool textMode = false) {
     isTextMode = textMode;
   }
+
+  // Text line layout, see TextFormat
+  // In the KEY_VALUE format, every fullLineInterval-th transmit interval prints every value, changed or not
+  // (0, the default, never does), so a reader that starts late still sees all dimensions.
+  void setTextFormat(TextFormat format, uint16_t fullLineInterval = 0) {
+    textFormat = format;
+    textFullLineInterval = fullLineInterval;
+    textLinesSinceFull = 0;
+  }
+#endif
   void setDeltaMode(bool deltaMode = false) {
     isDeltaMode = deltaMode;
   }
@@ -213,7 +1116,150 @@ public:
     hasBinaryWarningMessage = message;
   }
 
+  // Frame size, in bytes, including checksum, flag byte, COBS overhead and frame marker.
+  // Outgoing records are packed into frames up to this size, and longer incoming frames are dropped.
+  // The size is clamped to [TELEMETRYJET_MIN_FRAME_SIZE, TELEMETRYJET_MAX_FRAME_SIZE].
+  // Changing the size reallocates the buffers and discards any partially received frame.
+  // Returns false if the buffers could not be allocated.
+  bool setMaxFrameSize(uint16_t frameSize);
+  // 0 if the constructor could not allocate the buffers; update() then does nothing until setMaxFrameSize() succeeds
+  uint16_t getMaxFrameSize() {
+    return maxFrameSize;
+  }
+
+  // Link statistics: frame, byte, drop and loss counters since startup or the last reset
+  const LinkStatistics& getLinkStatistics() {
+    return linkStatistics;
+  }
+  void resetLinkStatistics();
+
+#if TELEMETRYJET_RX
+  // Frame and loss counters for the frames received on one transport: the main transport, or one added with
+  // addTransport. Returns NULL if the stream or driver isn't a binary or CAN transport of this instance.
+  const ReceiveStatistics* getReceiveStatistics(Stream* stream);
+  const ReceiveStatistics* getReceiveStatistics(CanDriver* driver);
+  // On a bus master, the counters for the frames received from one node. Returns NULL for other addresses.
+  const ReceiveStatistics* getBusNodeStatistics(uint8_t address);
+#endif
+
+  // Adaptive transmit rate
+  // When enabled, the instance watches for blocked writes and received frame loss.
+  // While the link is congested, low-priority dimensions are sent on fewer ticks,
+  // and they are brought back up to full rate once the link recovers.
+  void setAdaptiveRate(bool adaptiveRate = false) {
+    isAdaptiveRate = adaptiveRate;
+    decimationLevel = 0;
+    uncongestedTicks = 0;
+  }
+  // Current decimation level: 0 means every dimension is sent at the full rate
+  uint8_t getDecimationLevel() {
+    return decimationLevel;
+  }
+  // Bytes per second actually written to the transport, averaged over recent ticks
+  uint32_t getEffectiveRate() {
+    return effectiveRate;
+  }
+
+  // Time, in milliseconds, to wait for an acknowledgement before resending reliable frames
+#if TELEMETRYJET_RX
+  void setReliableTimeout(uint32_t timeout = TELEMETRYJET_RELIABLE_TIMEOUT) {
+    reliableTimeout = timeout;
+  }
+#endif
+
   friend class Dimension;
+  friend class Waveform;
+  template <typename T> friend class TypedDimension;
+};
+
+/*
+TypedDimension
+A Dimension whose value type is fixed when it is created, with TelemetryJet::createDimension<T>().
+Setters and getters are resolved at compile time: the value is always stored as T, so get() reads it without
+type checks or conversions, after the same timeout check as Dimension::hasValue().
+Values received from the host are converted to T on arrival, or dropped if they cannot be converted UP to T.
+*/
+template <typename T>
+class TypedDimension : private Dimension {
+ private:
+  TypedDimension(uint16_t id, TelemetryJet* parent) : Dimension(id, parent) {};
+ public:
+  // Write a value to this dimension; it will be sent on the next update interval tick in update()
+  void set(T value) {
+    setValue(value);
+  }
+
+  // Get the value of this dimension, or the default if a value is not available or it holds an array
+  T get(T defaultValue = T()) {
+    if (!hasValue() || _parent->dimensions[_id]->arrayLength > 0) {
+      return defaultValue;
+    }
+    return DataPointTraits<T>::load(_parent->dimensions[_id]->value);
+  }
+
+  // Write or read an array of values of type T, as in Dimension
+  void setArray(const T* values, uint8_t length) {
+    Dimension::setArray(values, length);
+  }
+  uint8_t getArray(T* values, uint8_t maxLength) {
+    return Dimension::getArray(values, maxLength);
+  }
+  using Dimension::getArrayLength;
+
+  // Bind to a variable or sampler function of type T, as in Dimension
+  void bind(T* variable) {
+    Dimension::bind(variable);
+  }
+  void bind(T (*sampler)()) {
+    Dimension::bind(sampler);
+  }
+  using Dimension::unbind;
+
+  // Write a value from an interrupt handler, as in Dimension
+  bool publish(T value) {
+    return Dimension::publish(value);
+  }
+
+  // Metadata and flags, as in Dimension
+  using Dimension::hasValue;
+  using Dimension::clearValue;
+  using Dimension::getSnapshot;
+  using Dimension::getKey;
+  using Dimension::getType;
+  using Dimension::getTimeoutAge;
+  using Dimension::getCurrentAge;
+  using Dimension::setTimeoutAge;
+  using Dimension::hasNewValue;
+  using Dimension::setPriority;
+  using Dimension::getPriority;
+  using Dimension::setUrgent;
+  using Dimension::isUrgent;
+#if TELEMETRYJET_RX
+  using Dimension::setReliable;
+#endif
+  using Dimension::isReliable;
+  using Dimension::isSubscribed;
+  using Dimension::setOnDemand;
+  using Dimension::setScale;
+  using Dimension::clearScale;
+  using Dimension::isScaled;
+
+  friend class TelemetryJet;
 };
 
+template <typename T>
+TypedDimension<T> TelemetryJet::createDimension(uint16_t key, uint32_t timeoutAge) {
+  Dimension dimension = createDimension(key, timeoutAge);
+  dimensions[dimension._id]->type = DataPointTraits<T>::type;
+  dimensions[dimension._id]->hasFixedType = true;
+  return TypedDimension<T>(dimension._id, this);
+}
+
+template <typename T>
+bool Dimension::publish(T value) {
+  DataPointValue publishedValue;
+  DataPointTraits<T>::store(publishedValue, value);
+  return _parent->publishValue(_id, DataPointTraits<T>::type, publishedValue);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*
+TelemetryJet Arduino SDK
+Chris Dalke <chrisdalke@gmail.com>
+
+Lightweight communication library for hardware telemetry data.
+Handles bidirectional communication and state management for data points.
+-------------------------------------------------------------------------
+Part of the TelemetryJet platform -- Collect, analyze, and share
+data from your hardware. Code not required.
+
+Distributed "as is" under the MIT License. See LICENSE.md for details.
+*/
+
+#ifndef __TELEMETRYJET_CONFIG_H__
+#define __TELEMETRYJET_CONFIG_H__
+
+/*
+Feature profile
+Selects which parts of the library are compiled in.
+Included by both TelemetryJet.h and MessagePack.h, so the library and the sketch always agree.
+
+The Arduino IDE compiles libraries separately from the sketch, so a #define in the sketch does not reach
+the library. To change these options, either edit the defaults below, or pass them as global build
+flags (for example, build_flags = -DTELEMETRYJET_PROFILE_MINIMAL in PlatformIO).
+
+Footprint of the library itself in each profile is listed in the README.
+*/
+
+// Minimal profile: binary transmit only.
+// Turns off text mode, 64-bit types and the receive path, unless they are enabled explicitly.
+// Data points keep most of their fields, so RAM per dimension only shrinks by a few bytes; see the README.
+#if defined(TELEMETRYJET_PROFILE_MINIMAL)
+#ifndef TELEMETRYJET_TEXT_MODE
+#define TELEMETRYJET_TEXT_MODE 0
+#endif
+#ifndef TELEMETRYJET_64BIT_TYPES
+#define TELEMETRYJET_64BIT_TYPES 0
+#endif
+#ifndef TELEMETRYJET_RX
+#define TELEMETRYJET_RX 0
+#endif
+#endif
+
+// Text mode output (setTextMode)
+#ifndef TELEMETRYJET_TEXT_MODE
+#define TELEMETRYJET_TEXT_MODE 1
+#endif
+
+// 64-bit integer types (UINT64, INT64)
+// Without them, each stored value shrinks from 8 to 4 bytes.
+#ifndef TELEMETRYJET_64BIT_TYPES
+#define TELEMETRYJET_64BIT_TYPES 1
+#endif
+
+// Receive path: values sent by the host, and every feature that needs replies from the host
+// (reliable delivery, subscriptions, read requests).
+// Without it, the instance only transmits.
+#ifndef TELEMETRYJET_RX
+#define TELEMETRYJET_RX 1
+#endif
+
+/*
+MPack configuration
+TelemetryJet only uses the Writer and Expect APIs on fixed buffers,
+so the dynamic Node API, stdio helpers, debug checks and error strings are left out.
+*/
+#define MPACK_NODE 0
+#define MPACK_STDIO 0
+#define MPACK_DEBUG 0
+#define MPACK_STRINGS 0
+#define MPACK_READ_TRACKING 0
+#define MPACK_WRITE_TRACKING 0
+#define MPACK_WRITER 1
+#define MPACK_READER TELEMETRYJET_RX
+#define MPACK_EXPECT TELEMETRYJET_RX
+
+// Only used by the Node API and growable buffers, which are not compiled in
+#define MPACK_STACK_SIZE 64
+#define MPACK_BUFFER_SIZE 64
+#define MPACK_NODE_PAGE_SIZE 64
+
+#if defined(__AVR__)
+#define MPACK_OPTIMIZE_FOR_SIZE 1
+#endif
+
+#endif
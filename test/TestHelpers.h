@@ -0,0 +1,55 @@
+/*
+Checks for the host tests
+A failed CHECK prints its location and is counted; each test's main() returns TEST_RESULT().
+*/
+
+#ifndef __TELEMETRYJET_TEST_HELPERS_H__
+#define __TELEMETRYJET_TEST_HELPERS_H__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+static int testFailures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      testFailures++; \
+    } \
+  } while (0)
+
+#define TEST_RESULT() (testFailures == 0 ? 0 : 1)
+
+// Split the bytes written to a binary transport into frames, each with its 0x00 delimiter, and clear them
+static inline std::vector<std::string> takeFrames(std::string& out) {
+  std::vector<std::string> frames;
+  size_t start = 0;
+  for (size_t i = 0; i < out.size(); i++) {
+    if (out[i] == 0) {
+      frames.push_back(out.substr(start, i + 1 - start));
+      start = i + 1;
+    }
+  }
+  out.erase(0, start);
+  return frames;
+}
+
+// MessagePack payload of a frame taken with takeFrames: the COBS data after the checksum and flag bytes, decoded
+static inline std::string framePayload(const std::string& frame, size_t headerLength = 2) {
+  std::string payload;
+  size_t i = headerLength;
+  size_t end = frame.size() - 1;
+  while (i < end) {
+    uint8_t code = frame[i++];
+    for (uint8_t j = 1; j < code && i < end; j++) {
+      payload.push_back(frame[i++]);
+    }
+    if (code != 0xFF && i < end) {
+      payload.push_back(0);
+    }
+  }
+  return payload;
+}
+
+#endif
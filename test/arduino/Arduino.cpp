@@ -0,0 +1,22 @@
+#include "Arduino.h"
+
+volatile uint32_t fakeMillis = 0;
+volatile uint32_t fakeMicros = 0;
+uint8_t fakePins[64];
+
+uint32_t millis() {
+  return fakeMillis + fakeMicros / 1000;
+}
+
+uint32_t micros() {
+  return fakeMillis * 1000 + fakeMicros;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  fakePins[pin] = value;
+}
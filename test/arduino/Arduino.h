@@ -0,0 +1,135 @@
+/*
+Minimal Arduino core for the host tests
+Only what TelemetryJet uses: Print, Stream, the clock and digital pins.
+The clock is driven by the tests through fakeMillis and fakeMicros.
+*/
+
+#ifndef __TELEMETRYJET_TEST_ARDUINO_H__
+#define __TELEMETRYJET_TEST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <deque>
+#include <string>
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 1
+
+extern volatile uint32_t fakeMillis;
+extern volatile uint32_t fakeMicros;
+extern uint8_t fakePins[64];
+
+uint32_t millis();
+uint32_t micros();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+class Print {
+ public:
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t count = 0;
+    while (size--) {
+      count += write(*buffer++);
+    }
+    return count;
+  }
+  size_t write(const char* s) {
+    return write((const uint8_t*)s, strlen(s));
+  }
+  size_t write(const char* s, size_t size) {
+    return write((const uint8_t*)s, size);
+  }
+  virtual int availableForWrite() {
+    return 0;
+  }
+  virtual void flush() {}
+  size_t print(const char* s) {
+    return write(s);
+  }
+  size_t print(const __FlashStringHelper* s) {
+    return write((const char*)s);
+  }
+  size_t print(long value) {
+    return print(std::to_string(value).c_str());
+  }
+  size_t print(unsigned long value) {
+    return print(std::to_string(value).c_str());
+  }
+  size_t print(int value) {
+    return print((long)value);
+  }
+  size_t print(unsigned int value) {
+    return print((unsigned long)value);
+  }
+  size_t print(double value, int digits = 2) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+    return print(buffer);
+  }
+  size_t println(const __FlashStringHelper* s) {
+    return print(s) + write("\r\n");
+  }
+  size_t println(const char* s) {
+    return print(s) + write("\r\n");
+  }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+/*
+TestStream
+In-memory stream: bytes written are appended to 'out', and bytes pushed to 'in' are read back.
+*/
+class TestStream : public Stream {
+ public:
+  std::deque<uint8_t> in;
+  std::string out;
+
+  using Print::write;
+  size_t write(uint8_t b) override {
+    out.push_back((char)b);
+    return 1;
+  }
+  int availableForWrite() override {
+    return 1 << 30;
+  }
+  int available() override {
+    return (int)in.size();
+  }
+  int read() override {
+    if (in.empty()) {
+      return -1;
+    }
+    int b = in.front();
+    in.pop_front();
+    return b;
+  }
+  int peek() override {
+    return in.empty() ? -1 : in.front();
+  }
+  // Move everything written so far into another stream's input
+  void sendTo(TestStream& other) {
+    other.in.insert(other.in.end(), out.begin(), out.end());
+    out.clear();
+  }
+};
+
+#endif
@@ -0,0 +1,266 @@
+/*
+Bus mode on a simulated half-duplex bus
+Every byte written by a device reaches every device on the bus, after 100 us on the wire. A byte written while
+another device's byte is still on the wire is a collision. In both schedules, every node's values must reach
+the master, the master's values must reach every node, and no two devices may talk at once, even when a burst of
+values is set just before the end of a slot. Only the bus carries the address byte; other transports don't.
+*/
+
+#include <TelemetryJet.h>
+#include "TestHelpers.h"
+
+#define BYTE_MICROS 100
+#define BAUD_RATE 100000
+
+struct Bus;
+
+struct BusPort final : public TestStream {
+  Bus* bus;
+  uint8_t id;
+  // Bytes still on the wire, with the time they arrive
+  std::deque<std::pair<uint64_t, uint8_t>> wire;
+
+  void arrive() {
+    while (!wire.empty() && wire.front().first <= (uint64_t)fakeMillis * 1000) {
+      in.push_back(wire.front().second);
+      wire.pop_front();
+    }
+  }
+  int available() override {
+    arrive();
+    return TestStream::available();
+  }
+  int read() override {
+    arrive();
+    return TestStream::read();
+  }
+  using Print::write;
+  size_t write(uint8_t b) override;
+};
+
+struct Bus {
+  std::vector<BusPort*> ports;
+  uint32_t collisions = 0;
+  int lastWriter = -1;
+  uint64_t busyUntil = 0;
+};
+
+size_t BusPort::write(uint8_t b) {
+  uint64_t now = (uint64_t)fakeMillis * 1000;
+  if (bus->lastWriter != id && now < bus->busyUntil) {
+    bus->collisions++;
+  }
+  if (bus->busyUntil < now) {
+    bus->busyUntil = now;
+  }
+  bus->busyUntil += BYTE_MICROS;
+  bus->lastWriter = id;
+  for (BusPort* port : bus->ports) {
+    port->wire.push_back(std::make_pair(bus->busyUntil, b));
+  }
+  return 1;
+}
+
+static void addPorts(Bus& bus, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    BusPort* port = new BusPort();
+    port->bus = &bus;
+    port->id = i;
+    bus.ports.push_back(port);
+  }
+}
+
+static void deletePorts(Bus& bus) {
+  for (BusPort* port : bus.ports) {
+    delete port;
+  }
+}
+
+static void testSchedule(BusSchedule schedule, uint8_t numNodes) {
+  Bus bus;
+  addPorts(bus, numNodes + 1);
+  fakeMillis = 1000;
+  TelemetryJet master(bus.ports[0], 50, 64);
+  CHECK(master.setBusMaster(schedule, numNodes, 5));
+  master.setBusBaudRate(BAUD_RATE);
+  master.setBusDirectionPin(7);
+  Dimension command = master.createDimension(1);
+  std::vector<Dimension> fromNodes, reliableFromNodes;
+  for (uint8_t i = 1; i <= numNodes; i++) {
+    fromNodes.push_back(master.createDimension(100 + i));
+    reliableFromNodes.push_back(master.createDimension(200 + i));
+  }
+
+  std::vector<TelemetryJet*> nodes;
+  std::vector<Dimension> values, reliableValues, commands;
+  for (uint8_t i = 1; i <= numNodes; i++) {
+    TelemetryJet* node = new TelemetryJet(bus.ports[i], 20, 64);
+    CHECK(node->setBusNode(i, schedule));
+    node->setBusBaudRate(BAUD_RATE);
+    // ACKs only come back in the master's slot, a few nodes per cycle
+    node->setReliableTimeout(1000);
+    values.push_back(node->createDimension(100 + i));
+    reliableValues.push_back(node->createDimension(200 + i));
+    reliableValues.back().setReliable(true);
+    commands.push_back(node->createDimension(1));
+    nodes.push_back(node);
+  }
+
+  command.setUInt16(77);
+  for (uint8_t i = 0; i < numNodes; i++) {
+    values[i].setUInt16(i * 10);
+    reliableValues[i].setUInt16(i * 10);
+  }
+  for (uint16_t t = 0; t < 2000; t++) {
+    fakeMillis = 1000 + t;
+    master.update();
+    for (TelemetryJet* node : nodes) {
+      node->update();
+    }
+    if (t == 1000) {
+      for (uint8_t i = 0; i < numNodes; i++) {
+        values[i].setUInt16(i * 10 + 1);
+        reliableValues[i].setUInt16(i * 10 + 1);
+      }
+    }
+  }
+
+  CHECK(bus.collisions == 0);
+  CHECK(fakePins[7] == LOW);
+  for (uint8_t i = 0; i < numNodes; i++) {
+    CHECK(fromNodes[i].hasValue() && fromNodes[i].getUInt16() == i * 10 + 1);
+    CHECK(reliableFromNodes[i].hasValue() && reliableFromNodes[i].getUInt16() == i * 10 + 1);
+    CHECK(commands[i].hasValue() && commands[i].getUInt16() == 77);
+    // Each node's frames and reliable frames are numbered on their own, and each node only takes its own ACKs
+    const ReceiveStatistics* statistics = master.getBusNodeStatistics(i + 1);
+    CHECK(statistics != NULL && statistics->rxFrames > 0 && statistics->rxLostFrames == 0);
+    CHECK(nodes[i]->getLinkStatistics().txRetransmittedFrames == 0);
+    CHECK(nodes[i]->getLinkStatistics().rxLostFrames == 0);
+  }
+  CHECK(master.getBusNodeStatistics(numNodes + 1) == NULL);
+  CHECK(master.getLinkStatistics().rxReliableDiscarded == 0);
+  CHECK(master.getLinkStatistics().rxDroppedChecksum == 0);
+
+  for (TelemetryJet* node : nodes) {
+    delete node;
+  }
+  deletePorts(bus);
+}
+
+// Bursts of values set at every point of a node's slot, including just before its end, only go out as far as the
+// slot allows, and the rest follows in the node's next slots
+static void testSlotEnd() {
+  Bus bus;
+  addPorts(bus, 3);
+  fakeMillis = 1000;
+  TelemetryJet master(bus.ports[0], 50, 64);
+  CHECK(master.setBusMaster(BusSchedule::SLOTTED, 2, 10));
+  master.setBusBaudRate(BAUD_RATE);
+  TelemetryJet burstNode(bus.ports[1], 1, 64);
+  CHECK(burstNode.setBusNode(1));
+  burstNode.setBusBaudRate(BAUD_RATE);
+  TelemetryJet busyNode(bus.ports[2], 1, 64);
+  CHECK(busyNode.setBusNode(2));
+  busyNode.setBusBaudRate(BAUD_RATE);
+
+  // The burst is about four slots' worth of bytes, and the other node sends in every one of its slots
+  std::vector<Dimension> burst, received;
+  for (uint16_t i = 0; i < 30; i++) {
+    burst.push_back(burstNode.createDimension(100 + i));
+    received.push_back(master.createDimension(100 + i));
+  }
+  Dimension counter = busyNode.createDimension(200);
+  Dimension receivedCounter = master.createDimension(200);
+
+  // Each burst starts 1 ms later in the 30 ms slot cycle than the one before
+  uint32_t t = 0;
+  for (uint32_t round = 0; round < 31; round++) {
+    for (uint16_t i = 0; i < 30; i++) {
+      burst[i].setUInt32(round * 100000 + i);
+    }
+    for (uint32_t end = t + 211; t < end; t++) {
+      fakeMillis = 1000 + t;
+      counter.setUInt32(t);
+      master.update();
+      burstNode.update();
+      busyNode.update();
+    }
+    for (uint16_t i = 0; i < 30; i++) {
+      CHECK(received[i].getUInt32() == round * 100000 + i);
+    }
+  }
+  CHECK(bus.collisions == 0);
+  CHECK(receivedCounter.getUInt32() > t - 40);
+  CHECK(master.getLinkStatistics().rxDroppedChecksum == 0);
+  CHECK(master.getBusNodeStatistics(1)->rxLostFrames == 0);
+  deletePorts(bus);
+}
+
+// A node's additional transport carries frames without the address byte, both ways, and routes between the bus
+// and that transport add or remove it
+static void testOtherTransports() {
+  Bus bus;
+  addPorts(bus, 2);
+  fakeMillis = 1000;
+  TelemetryJet master(bus.ports[0], 10, 64);
+  CHECK(master.setBusMaster(BusSchedule::SLOTTED, 1, 10));
+  master.setBusBaudRate(BAUD_RATE);
+  TestStream nodeLink;
+  TelemetryJet node(bus.ports[1], 10, 64);
+  CHECK(node.setBusNode(1));
+  node.setBusBaudRate(BAUD_RATE);
+  CHECK(node.addTransport(&nodeLink));
+  // A plain device on the node's other link
+  TestStream hostLink;
+  TelemetryJet host(&hostLink, 10, 64);
+  host.setBinaryWarningMessage(false);
+
+  // Key 3 goes from the master to the host through the node, and key 4 from the host to the master
+  CHECK(node.addRoute(bus.ports[1], &nodeLink, 3, 3));
+  CHECK(node.addRoute(&nodeLink, bus.ports[1], 4, 4));
+  Dimension nodeValue = node.createDimension(1);
+  Dimension nodeReceived = node.createDimension(2);
+  Dimension hostValue = host.createDimension(2);
+  Dimension hostRouted = host.createDimension(4);
+  Dimension hostReceived = host.createDimension(1);
+  Dimension hostFromMaster = host.createDimension(3);
+  Dimension masterValue = master.createDimension(3);
+  Dimension masterReceived = master.createDimension(1);
+  Dimension masterFromHost = master.createDimension(4);
+  nodeValue.setUInt16(5);
+  hostValue.setUInt16(6);
+  masterValue.setUInt16(8);
+
+  // Routes only look at the first record of a frame, so the routed value goes out later, in a frame of its own
+  for (uint16_t t = 0; t < 200; t++) {
+    fakeMillis = 1000 + t;
+    if (t == 100) {
+      hostRouted.setUInt16(7);
+    }
+    master.update();
+    node.update();
+    host.update();
+    nodeLink.sendTo(hostLink);
+    hostLink.sendTo(nodeLink);
+  }
+
+  CHECK(hostReceived.hasValue() && hostReceived.getUInt16() == 5);
+  CHECK(nodeReceived.hasValue() && nodeReceived.getUInt16() == 6);
+  CHECK(masterReceived.hasValue() && masterReceived.getUInt16() == 5);
+  CHECK(hostFromMaster.hasValue() && hostFromMaster.getUInt16() == 8);
+  CHECK(masterFromHost.hasValue() && masterFromHost.getUInt16() == 7);
+  CHECK(host.getLinkStatistics().rxDroppedChecksum == 0);
+  CHECK(node.getLinkStatistics().rxDroppedChecksum == 0);
+  CHECK(master.getLinkStatistics().rxDroppedChecksum == 0);
+  CHECK(node.getLinkStatistics().rxForwardedFrames > 0);
+  deletePorts(bus);
+}
+
+int main() {
+  testSchedule(BusSchedule::SLOTTED, 3);
+  testSchedule(BusSchedule::SLOTTED, 16);
+  testSchedule(BusSchedule::POLLED, 16);
+  testSlotEnd();
+  testOtherTransports();
+  return TEST_RESULT();
+}
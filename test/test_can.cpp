@@ -0,0 +1,152 @@
+/*
+CAN transports on a simulated bus
+A CAN-only device, with no stream at all, sends to a device serving the same bus next to its stream. Small values
+go in CAN frames of their own, the other records in a batch, and reliable frames are acknowledged over CAN. A
+lost segment drops its whole batch.
+*/
+
+#include <TelemetryJet.h>
+#include "TestHelpers.h"
+
+#define BASE_ID 0x100
+#define A_BATCH_ID 0x7F0
+#define B_BATCH_ID 0x7F1
+
+struct CanFrame {
+  uint32_t id;
+  uint8_t length;
+  uint8_t data[8];
+  uint8_t from;
+};
+
+struct MemoryBus {
+  std::vector<CanFrame> frames;
+  // Index of a frame to lose, counted over every write
+  int dropIndex = -1;
+  int numWrites = 0;
+};
+
+struct MemoryCan : public CanDriver {
+  MemoryBus* bus;
+  uint8_t node;
+  size_t readIndex = 0;
+
+  MemoryCan(MemoryBus* bus, uint8_t node) : bus(bus), node(node) {}
+  bool write(uint32_t id, const uint8_t* data, uint8_t length) override {
+    CHECK(length <= 8);
+    if (bus->numWrites++ == bus->dropIndex) {
+      return true;
+    }
+    CanFrame frame;
+    frame.id = id;
+    frame.length = length;
+    memcpy(frame.data, data, length);
+    frame.from = node;
+    bus->frames.push_back(frame);
+    return true;
+  }
+  bool read(uint32_t* id, uint8_t* data, uint8_t* length) override {
+    while (readIndex < bus->frames.size()) {
+      CanFrame& frame = bus->frames[readIndex++];
+      if (frame.from == node) {
+        continue;
+      }
+      *id = frame.id;
+      *length = frame.length;
+      memcpy(data, frame.data, frame.length);
+      return true;
+    }
+    return false;
+  }
+};
+
+int main() {
+  MemoryBus bus;
+  MemoryCan canA(&bus, 1), canB(&bus, 2);
+  TestStream streamB;
+  TelemetryJet a(&canA, BASE_ID, A_BATCH_ID, B_BATCH_ID, 100, 128);
+  TelemetryJet b(&streamB, 100, 128);
+  b.setBinaryWarningMessage(false);
+  CHECK(b.addTransport(&canB, BASE_ID, B_BATCH_ID, A_BATCH_ID));
+  // Bus mode needs a stream
+  CHECK(!a.setBusNode(1));
+
+  std::vector<Dimension> fromA, atB;
+  for (uint16_t key = 1; key <= 7; key++) {
+    fromA.push_back(a.createDimension(key));
+    atB.push_back(b.createDimension(key));
+  }
+  float array[10];
+  for (uint8_t i = 0; i < 10; i++) {
+    array[i] = i * 0.5f;
+  }
+  fromA[0].setBool(true);
+  fromA[1].setInt16(-1234);
+  fromA[2].setFloat32(3.25f);
+  fromA[3].setUInt64(0x123456789ABCULL);
+  fromA[4].setFloat16(1.5f);
+  fromA[5].setArray(array, 10);
+  fromA[6].setUInt32(0xDEADBEEF);
+  fakeMillis = 200;
+  a.update();
+  b.update();
+
+  CHECK(atB[0].getBool());
+  CHECK(atB[1].getInt16() == -1234);
+  CHECK(atB[2].getFloat32() == 3.25f);
+  CHECK(atB[3].getUInt64() == 0x123456789ABCULL);
+  CHECK(atB[4].getFloat32() == 1.5f);
+  CHECK(atB[6].getUInt32() == 0xDEADBEEF);
+  float received[10];
+  CHECK(atB[5].getArray(received, 10) == 10);
+  CHECK(memcmp(received, array, sizeof(array)) == 0);
+  // Five values in frames of their own, and the 64-bit value and the array in one batch
+  uint8_t numValueFrames = 0;
+  for (CanFrame& frame : bus.frames) {
+    if (frame.id != A_BATCH_ID) {
+      CHECK(frame.id >= BASE_ID + 1 && frame.id <= BASE_ID + 7);
+      numValueFrames++;
+    }
+  }
+  CHECK(numValueFrames == 5);
+  CHECK(bus.frames[numValueFrames].id == A_BATCH_ID && bus.frames[numValueFrames].data[0] >> 4 == 0x1);
+  CHECK(a.getLinkStatistics().txFrames == 1);
+  CHECK(streamB.out.empty());
+
+  // A reliable value is acknowledged over CAN, so it is never sent again
+  fromA[2].setReliable(true);
+  fromA[2].setFloat32(7.5f);
+  fakeMillis = 400;
+  a.update();
+  fakeMillis = 401;
+  b.update();
+  fakeMillis = 402;
+  a.update();
+  CHECK(atB[2].getFloat32() == 7.5f);
+  fakeMillis = 1000;
+  a.update();
+  b.update();
+  CHECK(a.getLinkStatistics().txRetransmittedFrames == 0);
+  const ReceiveStatistics* statistics = b.getReceiveStatistics(&canB);
+  CHECK(statistics != NULL && statistics->rxFrames > 0);
+
+  // A lost segment drops the whole batch
+  uint32_t dropped = b.getLinkStatistics().rxDroppedDecode;
+  fromA[3].setUInt64(42);
+  fromA[5].setArray(array, 10);
+  bus.dropIndex = bus.numWrites + 1;
+  fakeMillis = 1200;
+  a.update();
+  b.update();
+  CHECK(atB[3].getUInt64() == 0x123456789ABCULL);
+  CHECK(b.getLinkStatistics().rxDroppedDecode > dropped);
+
+  // Values set at B reach the CAN-only device, while B's stream gets them too
+  atB[1].setInt16(99);
+  fakeMillis = 1400;
+  b.update();
+  a.update();
+  CHECK(fromA[1].getInt16() == 99);
+  CHECK(!streamB.out.empty());
+  return TEST_RESULT();
+}
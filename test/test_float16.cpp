@@ -0,0 +1,104 @@
+/*
+Half precision floats
+setFloat16 rounds to the nearest half precision value, ties to even, like the compiler's own _Float16 conversion.
+Every half value survives the round trip, including subnormals and infinities, and NaN stays NaN, locally and
+across a link.
+*/
+
+#include <TelemetryJet.h>
+#include "TestHelpers.h"
+
+static float halfBitsToFloat(uint16_t bits) {
+  _Float16 half;
+  memcpy(&half, &bits, sizeof(half));
+  return (float)half;
+}
+
+static bool isSameFloat(float a, float b) {
+  if (isnan(a) || isnan(b)) {
+    return isnan(a) && isnan(b);
+  }
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static float roundTrip(Dimension& dimension, float value) {
+  dimension.setFloat16(value);
+  return dimension.getFloat16();
+}
+
+static void testEveryHalfValue() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 10);
+  Dimension dimension = telemetry.createDimension(1);
+  uint32_t mismatches = 0;
+  for (uint32_t bits = 0; bits <= 0xFFFF; bits++) {
+    float value = halfBitsToFloat(bits);
+    if (!isSameFloat(roundTrip(dimension, value), value)) {
+      mismatches++;
+    }
+  }
+  CHECK(mismatches == 0);
+}
+
+static void testRounding() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 10);
+  Dimension dimension = telemetry.createDimension(1);
+  // Every float bit pattern in steps that cover all exponents, and the mantissa bits below the half precision ones
+  uint32_t mismatches = 0;
+  for (uint64_t bits = 0; bits <= 0xFFFFFFFFULL; bits += 0x1FFF) {
+    float value;
+    uint32_t floatBits = (uint32_t)bits;
+    memcpy(&value, &floatBits, sizeof(value));
+    if (!isSameFloat(roundTrip(dimension, value), (float)(_Float16)value)) {
+      mismatches++;
+    }
+  }
+  CHECK(mismatches == 0);
+
+  // Ties go to the even neighbour
+  CHECK(roundTrip(dimension, 1.0f + 1.0f / 2048) == 1.0f);
+  CHECK(roundTrip(dimension, 1.0f + 3.0f / 2048) == 1.0f + 2.0f / 1024);
+  CHECK(roundTrip(dimension, 2049.0f) == 2048.0f);
+  CHECK(roundTrip(dimension, 2051.0f) == 2052.0f);
+  // Subnormals, and values below the smallest one
+  CHECK(roundTrip(dimension, ldexpf(1, -24)) == ldexpf(1, -24));
+  CHECK(roundTrip(dimension, ldexpf(3, -25)) == ldexpf(1, -23));
+  CHECK(roundTrip(dimension, ldexpf(1, -25)) == 0.0f);
+  CHECK(roundTrip(dimension, ldexpf(1, -15) * 1.5f) == ldexpf(1, -15) * 1.5f);
+  // Largest value, overflow, infinities and NaN
+  CHECK(roundTrip(dimension, 65504.0f) == 65504.0f);
+  CHECK(roundTrip(dimension, 65519.0f) == 65504.0f);
+  CHECK(isinf(roundTrip(dimension, 65520.0f)));
+  CHECK(roundTrip(dimension, -INFINITY) == -INFINITY);
+  CHECK(isnan(roundTrip(dimension, NAN)));
+  CHECK(signbit(roundTrip(dimension, -0.0f)));
+}
+
+static void testReceived() {
+  TestStream hostStream, deviceStream;
+  TelemetryJet host(&hostStream, 10);
+  TelemetryJet device(&deviceStream, 10);
+  host.setBinaryWarningMessage(false);
+  device.setBinaryWarningMessage(false);
+  Dimension source = host.createDimension(1);
+  Dimension received = device.createDimension(1);
+  const float values[] = {1.5f, -ldexpf(5, -24), 65504.0f, INFINITY, NAN, 0.1f};
+  for (float value : values) {
+    source.setFloat16(value);
+    fakeMillis += 10;
+    host.update();
+    hostStream.sendTo(deviceStream);
+    device.update();
+    CHECK(received.getType() == DataPointType::FLOAT16);
+    CHECK(isSameFloat(received.getFloat16(), (float)(_Float16)value));
+    CHECK(isSameFloat(received.getFloat32(), (float)(_Float16)value));
+  }
+}
+
+int main() {
+  testEveryHalfValue();
+  testRounding();
+  testReceived();
+  return TEST_RESULT();
+}
@@ -0,0 +1,97 @@
+/*
+Received values and fixed types
+Typed and bound dimensions keep their type: values from the host that don't fit it, including array records,
+are dropped instead of changing the type or writing past a bound variable.
+*/
+
+#include <TelemetryJet.h>
+#include "TestHelpers.h"
+
+struct Link {
+  TestStream hostStream;
+  TestStream deviceStream;
+  TelemetryJet host;
+  TelemetryJet device;
+  Link() : host(&hostStream, 10), device(&deviceStream, 10) {
+    host.setBinaryWarningMessage(false);
+    device.setBinaryWarningMessage(false);
+  }
+  // Send everything the host has set to the device
+  void send() {
+    fakeMillis += 10;
+    host.update();
+    hostStream.sendTo(deviceStream);
+    device.update();
+  }
+};
+
+static void testBoundVariable() {
+  Link link;
+  Dimension source = link.host.createDimension(1);
+  struct {
+    uint8_t value;
+    uint8_t guard[3];
+  } variable = {7, {0xAA, 0xAA, 0xAA}};
+  Dimension bound = link.device.createDimension(1);
+  bound.bind(&variable.value);
+
+  int32_t array[3] = {1, 2, 3};
+  source.setArray(array, 3);
+  link.send();
+  CHECK(bound.getArrayLength() == 0);
+  CHECK(bound.getType() == DataPointType::UINT8);
+
+  source.setInt32(4);
+  link.send();
+  CHECK(variable.value == 7);
+  CHECK(variable.guard[0] == 0xAA && variable.guard[1] == 0xAA && variable.guard[2] == 0xAA);
+
+  source.setUInt8(5);
+  link.send();
+  CHECK(variable.value == 5);
+}
+
+static void testTypedDimension() {
+  Link link;
+  Dimension source = link.host.createDimension(1);
+  TypedDimension<float> typed = link.device.createDimension<float>(1);
+
+  int32_t array[2] = {1, 2};
+  source.setArray(array, 2);
+  link.send();
+  CHECK(!typed.hasValue());
+  CHECK(typed.getType() == DataPointType::FLOAT32);
+
+  source.setFloat32(2.5f);
+  link.send();
+  CHECK(typed.get() == 2.5f);
+  CHECK(typed.getType() == DataPointType::FLOAT32);
+
+  // Arrays of its own type are accepted
+  float floats[2] = {1.5f, 2.5f};
+  source.setArray(floats, 2);
+  link.send();
+  CHECK(typed.getArrayLength() == 2);
+  CHECK(typed.getType() == DataPointType::FLOAT32);
+}
+
+static void testUntypedDimension() {
+  Link link;
+  Dimension source = link.host.createDimension(1);
+  Dimension untyped = link.device.createDimension(1);
+
+  int32_t array[2] = {1, 2};
+  source.setArray(array, 2);
+  link.send();
+  int32_t received[2] = {0, 0};
+  CHECK(untyped.getArray(received, 2) == 2);
+  CHECK(untyped.getType() == DataPointType::INT32);
+  CHECK(received[0] == 1 && received[1] == 2);
+}
+
+int main() {
+  testBoundVariable();
+  testTypedDimension();
+  testUntypedDimension();
+  return TEST_RESULT();
+}
@@ -0,0 +1,195 @@
+/*
+Reliable delivery (go-back-N)
+The sender keeps up to TELEMETRYJET_RELIABLE_WINDOW unacknowledged frames, and once the oldest has timed out,
+sends all of them again from there. ACKs are cumulative, so a late ACK changes nothing. The receiver only accepts
+the next frame in order, so each frame is applied exactly once. setReliable fails cleanly without memory.
+*/
+
+#include <TelemetryJet.h>
+#include "TestHelpers.h"
+
+extern "C" void* __libc_malloc(size_t size);
+
+// Allocations fail while set, to test the out of memory paths
+static bool isMallocFailing = false;
+
+extern "C" void* malloc(size_t size) {
+  return isMallocFailing ? NULL : __libc_malloc(size);
+}
+
+static uint32_t numApplied = 0;
+
+static void countApplied(Dimension) {
+  numApplied++;
+}
+
+struct Link {
+  TestStream senderStream;
+  TestStream receiverStream;
+  TelemetryJet sender;
+  TelemetryJet receiver;
+  Dimension value;
+  Dimension received;
+  Link() : sender(&senderStream, 10), receiver(&receiverStream, 10),
+      value(sender.createDimension(1)), received(receiver.createDimension(1)) {
+    sender.setBinaryWarningMessage(false);
+    receiver.setBinaryWarningMessage(false);
+    CHECK(value.setReliable(true));
+    receiver.onReceive(1, countApplied);
+    numApplied = 0;
+  }
+  // Run the sender for a tick, and take the frames it sent
+  std::vector<std::string> tick() {
+    fakeMillis += 10;
+    sender.update();
+    return takeFrames(senderStream.out);
+  }
+  // Deliver a frame to the receiver, and take the frames it answered with
+  std::vector<std::string> deliver(const std::string& frame) {
+    receiverStream.in.insert(receiverStream.in.end(), frame.begin(), frame.end());
+    receiver.update();
+    return takeFrames(receiverStream.out);
+  }
+  // Deliver ACK frames back to the sender
+  void acknowledge(const std::vector<std::string>& acks) {
+    for (const std::string& ack : acks) {
+      senderStream.in.insert(senderStream.in.end(), ack.begin(), ack.end());
+    }
+  }
+};
+
+static void testRetransmitAfterTimeout() {
+  Link link;
+  link.value.setUInt8(1);
+  std::vector<std::string> sent = link.tick();
+  CHECK(sent.size() == 1);
+
+  // The frame is lost; nothing is resent before the timeout
+  CHECK(link.tick().empty());
+  fakeMillis += TELEMETRYJET_RELIABLE_TIMEOUT;
+  std::vector<std::string> resent = link.tick();
+  CHECK(resent.size() == 1);
+  CHECK(link.sender.getLinkStatistics().txRetransmittedFrames == 1);
+
+  std::vector<std::string> acks = link.deliver(resent[0]);
+  CHECK(acks.size() == 1);
+  CHECK(link.received.getUInt8() == 1);
+  link.acknowledge(acks);
+  link.tick();
+
+  // Acknowledged: never sent again
+  fakeMillis += TELEMETRYJET_RELIABLE_TIMEOUT;
+  CHECK(link.tick().empty());
+  CHECK(link.sender.getLinkStatistics().txRetransmittedFrames == 1);
+}
+
+static void testFullWindow() {
+  Link link;
+  std::vector<std::string> frames;
+  for (uint8_t i = 1; i <= TELEMETRYJET_RELIABLE_WINDOW + 2; i++) {
+    link.value.setUInt8(i);
+    std::vector<std::string> sent = link.tick();
+    frames.insert(frames.end(), sent.begin(), sent.end());
+  }
+  // Only a full window went out; the latest value waits for room
+  CHECK(frames.size() == TELEMETRYJET_RELIABLE_WINDOW);
+
+  // Once the window is acknowledged, the latest value follows in one frame
+  std::vector<std::string> acks;
+  for (const std::string& frame : frames) {
+    std::vector<std::string> ack = link.deliver(frame);
+    acks.insert(acks.end(), ack.begin(), ack.end());
+  }
+  CHECK(link.received.getUInt8() == TELEMETRYJET_RELIABLE_WINDOW);
+  link.acknowledge(acks);
+  std::vector<std::string> sent = link.tick();
+  CHECK(sent.size() == 1);
+  link.deliver(sent[0]);
+  CHECK(link.received.getUInt8() == TELEMETRYJET_RELIABLE_WINDOW + 2);
+  CHECK(numApplied == TELEMETRYJET_RELIABLE_WINDOW + 1);
+}
+
+static void testAcksOutOfOrder() {
+  Link link;
+  std::vector<std::vector<std::string>> acks;
+  for (uint8_t i = 1; i <= 3; i++) {
+    link.value.setUInt8(i);
+    std::vector<std::string> sent = link.tick();
+    CHECK(sent.size() == 1);
+    acks.push_back(link.deliver(sent[0]));
+  }
+  // The last ACK covers every frame; the earlier ones arrive late and change nothing
+  link.acknowledge(acks[2]);
+  link.acknowledge(acks[0]);
+  link.acknowledge(acks[1]);
+  link.tick();
+  fakeMillis += TELEMETRYJET_RELIABLE_TIMEOUT;
+  CHECK(link.tick().empty());
+  CHECK(link.sender.getLinkStatistics().txRetransmittedFrames == 0);
+
+  // The sequence carries on where it was
+  link.value.setUInt8(4);
+  std::vector<std::string> sent = link.tick();
+  CHECK(sent.size() == 1);
+  link.deliver(sent[0]);
+  CHECK(link.received.getUInt8() == 4);
+  CHECK(link.receiver.getLinkStatistics().rxReliableDiscarded == 0);
+}
+
+static void testAppliedOnce() {
+  Link link;
+  std::vector<std::string> frames;
+  for (uint8_t i = 1; i <= 3; i++) {
+    link.value.setUInt8(i);
+    std::vector<std::string> sent = link.tick();
+    frames.insert(frames.end(), sent.begin(), sent.end());
+  }
+  CHECK(frames.size() == 3);
+
+  // Frame 2 is lost: frame 3 is skipped until frame 2 arrives, and repeats are skipped too
+  link.deliver(frames[0]);
+  link.deliver(frames[0]);
+  link.deliver(frames[2]);
+  CHECK(link.received.getUInt8() == 1);
+  CHECK(numApplied == 1);
+  CHECK(link.receiver.getLinkStatistics().rxReliableDiscarded == 2);
+
+  // The sender goes back to frame 2 and sends everything from there again
+  fakeMillis += TELEMETRYJET_RELIABLE_TIMEOUT;
+  std::vector<std::string> resent = link.tick();
+  CHECK(resent.size() == 3);
+  for (const std::string& frame : resent) {
+    link.deliver(frame);
+  }
+  CHECK(link.received.getUInt8() == 3);
+  CHECK(numApplied == 3);
+}
+
+static void testOutOfMemory() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 10);
+  Dimension value = telemetry.createDimension(1);
+  isMallocFailing = true;
+  CHECK(!value.setReliable(true));
+  isMallocFailing = false;
+  CHECK(!value.isReliable());
+
+  // The old buffers are still in place, and values go out unreliably
+  value.setUInt8(5);
+  fakeMillis += 10;
+  telemetry.update();
+  CHECK(takeFrames(stream.out).size() == 1);
+
+  // With memory, the same dimension becomes reliable
+  CHECK(value.setReliable(true));
+  CHECK(value.isReliable());
+}
+
+int main() {
+  testRetransmitAfterTimeout();
+  testFullWindow();
+  testAcksOutOfOrder();
+  testAppliedOnce();
+  testOutOfMemory();
+  return TEST_RESULT();
+}
@@ -0,0 +1,149 @@
+/*
+Scaled values
+A float dimension with a scale is sent as a whole number of steps, rounded to the nearest step and clamped to the
+range, in the smallest MessagePack integer that holds it. The scale record goes first, and the receiver turns the
+steps back into floats. Arrays are sent as plain floats.
+*/
+
+#include <TelemetryJet.h>
+#include <MessagePack.h>
+#include "TestHelpers.h"
+
+struct Record {
+  uint16_t key;
+  uint8_t type;
+  // First byte of the encoded value, which gives its MessagePack type and width
+  uint8_t format;
+};
+
+struct Link {
+  TestStream hostStream;
+  TestStream deviceStream;
+  TelemetryJet host;
+  TelemetryJet device;
+  Link() : host(&hostStream, 10), device(&deviceStream, 10) {
+    host.setBinaryWarningMessage(false);
+    device.setBinaryWarningMessage(false);
+  }
+  // Send everything the host has set to the device, and list the records that were sent
+  std::vector<Record> send() {
+    fakeMillis += 10;
+    host.update();
+    std::string out = hostStream.out;
+    hostStream.sendTo(deviceStream);
+    device.update();
+
+    std::vector<Record> records;
+    for (const std::string& frame : takeFrames(out)) {
+      std::string payload = framePayload(frame);
+      mpack_reader_t reader;
+      mpack_reader_init_data(&reader, payload.data(), payload.size());
+      while (mpack_reader_remaining(&reader, NULL) > 0 && mpack_reader_error(&reader) == mpack_ok) {
+        Record record;
+        record.key = mpack_expect_u16(&reader);
+        record.type = mpack_expect_u8(&reader);
+        record.format = payload[payload.size() - mpack_reader_remaining(&reader, NULL)];
+        mpack_discard(&reader);
+        records.push_back(record);
+      }
+      CHECK(mpack_reader_destroy(&reader) == mpack_ok);
+    }
+    return records;
+  }
+};
+
+static void testRoundingAndClamping() {
+  Link link;
+  Dimension voltage = link.host.createDimension(5);
+  Dimension received = link.device.createDimension(5);
+  CHECK(voltage.setScale(0, 60, 0.01f));
+  CHECK(voltage.isScaled());
+
+  // The scale record goes with the first value
+  voltage.setFloat32(12.345f);
+  std::vector<Record> records = link.send();
+  CHECK(records.size() == 2);
+  CHECK(records[0].type == TELEMETRYJET_SCALE_TYPE && records[1].type == TELEMETRYJET_SCALED_VALUE_TYPE);
+  CHECK(received.getFloat32() == 1235 * 0.01f);
+  // Only the link loses precision
+  CHECK(voltage.getFloat32() == 12.345f);
+
+  voltage.setFloat32(12.344f);
+  records = link.send();
+  CHECK(records.size() == 1 && records[0].type == TELEMETRYJET_SCALED_VALUE_TYPE);
+  CHECK(received.getFloat32() == 1234 * 0.01f);
+
+  // Out of range values are clamped, and NaN goes to the minimum
+  voltage.setFloat32(100.0f);
+  link.send();
+  CHECK(received.getFloat32() == 6000 * 0.01f);
+  voltage.setFloat32(-5.0f);
+  link.send();
+  CHECK(received.getFloat32() == 0.0f);
+  voltage.setFloat32(NAN);
+  link.send();
+  CHECK(received.getFloat32() == 0.0f);
+}
+
+static void testIntegerWidth() {
+  Link link;
+  Dimension value = link.host.createDimension(1);
+  CHECK(value.setScale(0, 60, 0.01f));
+  const struct {
+    float value;
+    uint8_t format;
+  } cases[] = {
+    {1.0f, 100},      // positive fixint
+    {2.0f, 0xCC},     // uint8
+    {60.0f, 0xCD},    // uint16
+  };
+  for (auto& c : cases) {
+    value.setFloat32(c.value);
+    std::vector<Record> records = link.send();
+    CHECK(!records.empty() && records.back().type == TELEMETRYJET_SCALED_VALUE_TYPE);
+    CHECK(!records.empty() && records.back().format == c.format);
+  }
+
+  // A range of more than 16 bits of steps
+  CHECK(value.setScale(0, 100000, 0.01f));
+  value.setFloat32(100000.0f);
+  std::vector<Record> records = link.send();
+  CHECK(!records.empty() && records.back().format == 0xCE);
+}
+
+static void testRejectedScales() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 10);
+  Dimension value = telemetry.createDimension(1);
+  CHECK(value.setScale(0, 4.0e9f, 1));
+  CHECK(!value.setScale(0, 5.0e9f, 1));
+  CHECK(!value.isScaled());
+  CHECK(!value.setScale(0, 1, 0));
+  CHECK(!value.setScale(0, 1, -1));
+  CHECK(!value.setScale(1, 0, 0.1f));
+  CHECK(!value.setScale(0, NAN, 0.1f));
+  CHECK(!value.isScaled());
+}
+
+static void testArraysArePlainFloats() {
+  Link link;
+  Dimension samples = link.host.createDimension(2);
+  Dimension received = link.device.createDimension(2);
+  CHECK(samples.setScale(0, 10, 0.5f));
+  float values[3] = {0.1f, 2.3f, 9.99f};
+  samples.setArray(values, 3);
+  std::vector<Record> records = link.send();
+  CHECK(records.size() == 1);
+  CHECK(records[0].type == ((uint8_t)DataPointType::FLOAT32 | TELEMETRYJET_ARRAY_TYPE_FLAG));
+  float out[3];
+  CHECK(received.getArray(out, 3) == 3);
+  CHECK(memcmp(out, values, sizeof(values)) == 0);
+}
+
+int main() {
+  testRoundingAndClamping();
+  testIntegerWidth();
+  testRejectedScales();
+  testArraysArePlainFloats();
+  return TEST_RESULT();
+}
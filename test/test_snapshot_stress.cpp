@@ -0,0 +1,61 @@
+/*
+Snapshot reads from other threads while the main thread writes values
+Each snapshot must match a state the dimension was actually in: the 64-bit value is never torn, its timestamp
+matches it, and hasValue is never paired with a value written before or after it.
+*/
+
+#include <TelemetryJet.h>
+#include <atomic>
+#include <thread>
+#include "TestHelpers.h"
+
+#define WRITES 1000000
+
+int main() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 1000000, 64);
+  telemetry.setBinaryWarningMessage(false);
+  Dimension dimension = telemetry.createDimension(1);
+
+  std::atomic<bool> isDone(false);
+  std::atomic<long> snapshots(0), torn(0), staleFlag(0);
+  auto reader = [&] {
+    DataPointSnapshot snapshot;
+    while (!isDone) {
+      if (!dimension.getSnapshot(&snapshot) || snapshot.type != DataPointType::INT64) {
+        continue;
+      }
+      snapshots++;
+      uint32_t low = (uint32_t)snapshot.value.v_int64;
+      uint32_t high = (uint32_t)(snapshot.value.v_int64 >> 32);
+      if (low != high || low != snapshot.timestamp) {
+        torn++;
+      }
+      // Only even values are ever cleared, so an odd value without hasValue never existed
+      if ((low & 1) && !snapshot.hasValue) {
+        staleFlag++;
+      }
+    }
+  };
+  std::thread reader1(reader), reader2(reader);
+
+  for (uint32_t i = 1; i <= WRITES; i++) {
+    fakeMillis = i;
+    dimension.setInt64(((int64_t)i << 32) | i);
+    if ((i & 1) == 0) {
+      dimension.clearValue();
+    }
+    if ((i & 1023) == 0) {
+      telemetry.update();
+    }
+  }
+  isDone = true;
+  reader1.join();
+  reader2.join();
+
+  printf("snapshots %ld torn %ld stale hasValue %ld\n", (long)snapshots, (long)torn, (long)staleFlag);
+  CHECK(snapshots > 0);
+  CHECK(torn == 0);
+  CHECK(staleFlag == 0);
+  return TEST_RESULT();
+}
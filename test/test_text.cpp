@@ -0,0 +1,141 @@
+/*
+Text lines
+A line is written to the stream with a single write() whenever it fits in the frame buffer, even with the small
+frames used on AVR. Longer lines are written in parts, without losing or reordering characters.
+In delta mode, the KEY_VALUE format prints only the changed values, plus every value on each full line.
+Text transports next to a binary link sample bound dimensions themselves, so their lines are never stale.
+*/
+
+#include <TelemetryJet.h>
+#include "TestHelpers.h"
+
+// Counts the write() calls of whole buffers, as a USB serial port would send them
+class CountingStream : public TestStream {
+ public:
+  uint32_t numWrites = 0;
+
+  using TestStream::write;
+  size_t write(const uint8_t* buffer, size_t size) override {
+    numWrites++;
+    out.append((const char*)buffer, size);
+    return size;
+  }
+};
+
+static void testOneWritePerLine() {
+  CountingStream stream;
+  TelemetryJet telemetry(&stream, 10, 32);
+  telemetry.setTextMode(true);
+  std::vector<Dimension> dimensions;
+  for (uint16_t key = 1; key <= 8; key++) {
+    dimensions.push_back(telemetry.createDimension(key));
+    dimensions.back().setUInt8(key);
+  }
+  fakeMillis += 10;
+  telemetry.update();
+  CHECK(stream.out == "1 2 3 4 5 6 7 8 \n");
+  CHECK(stream.numWrites == 1);
+
+  // The same, with a key:value pair per changed dimension
+  telemetry.setTextFormat(TextFormat::KEY_VALUE);
+  stream.out.clear();
+  stream.numWrites = 0;
+  for (uint8_t i = 0; i < 5; i++) {
+    dimensions[i].setUInt8(9);
+  }
+  fakeMillis += 10;
+  telemetry.update();
+  CHECK(stream.out == "1:9 2:9 3:9 4:9 5:9 \n");
+  CHECK(stream.numWrites == 1);
+}
+
+static void testLongLine() {
+  CountingStream stream;
+  TelemetryJet telemetry(&stream, 10, 32);
+  telemetry.setTextMode(true);
+  std::string expected;
+  for (uint16_t key = 1; key <= 8; key++) {
+    telemetry.createDimension(key).setFloat32(1234.5f + key);
+    expected += std::to_string(1234 + key) + ".50 ";
+  }
+  expected += "\n";
+  fakeMillis += 10;
+  telemetry.update();
+  CHECK(stream.out == expected);
+  // 65 characters, in parts of at most 32
+  CHECK(stream.numWrites == 3);
+}
+
+static void testKeyValueDelta() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 10);
+  telemetry.setTextMode(true);
+  // Every third line is a full line
+  telemetry.setTextFormat(TextFormat::KEY_VALUE, 3);
+  Dimension speed = telemetry.createDimension(1);
+  Dimension mode = telemetry.createDimension(2);
+  Dimension cells = telemetry.createDimension(3);
+  Dimension unset = telemetry.createDimension(4);
+  uint16_t voltages[2] = {41, 42};
+  cells.setArray(voltages, 2);
+  mode.setUInt8(7);
+
+  const char* expected[] = {
+    "1:10 2:7 3_0:41 3_1:42 \n",
+    "1:11 \n",
+    "",
+    "1:13 2:7 3_0:41 3_1:42 \n",
+    "1:14 \n",
+  };
+  for (uint8_t i = 0; i < 5; i++) {
+    // Speed changes on every line but the third, where nothing changes and no full line is due
+    if (i != 2) {
+      speed.setUInt8(10 + i);
+    }
+    fakeMillis += 10;
+    telemetry.update();
+    CHECK(stream.out == expected[i]);
+    stream.out.clear();
+  }
+  CHECK(!unset.hasValue());
+
+  // Without delta mode, every line is a full line
+  telemetry.setDeltaMode(false);
+  fakeMillis += 10;
+  telemetry.update();
+  CHECK(stream.out == "1:14 2:7 3_0:41 3_1:42 \n");
+}
+
+static void testTextTransportSampling() {
+  TestStream binaryStream, textStream;
+  // The binary link only ticks once a second, and the text transport prints every 100ms
+  TelemetryJet telemetry(&binaryStream, 1000);
+  telemetry.setBinaryWarningMessage(false);
+  CHECK(telemetry.addTransport(&textStream, TransportMode::TEXT, 100));
+  uint16_t current = 1;
+  uint8_t onDemandCount = 1;
+  Dimension bound = telemetry.createDimension(1);
+  bound.bind(&current);
+  // Unsubscribed on the binary link, so the binary ticks never sample it
+  Dimension onDemand = telemetry.createDimension(2);
+  onDemand.bind(&onDemandCount);
+  onDemand.setOnDemand();
+
+  for (uint8_t i = 1; i <= 3; i++) {
+    current = i * 100;
+    onDemandCount = i;
+    fakeMillis += 100;
+    telemetry.update();
+    std::string expected = std::to_string(i * 100) + " " + std::to_string(i) + " \n";
+    CHECK(textStream.out == expected);
+    textStream.out.clear();
+  }
+}
+
+int main() {
+  testOneWritePerLine();
+  testLongLine();
+  testKeyValueDelta();
+  testTextTransportSampling();
+  return TEST_RESULT();
+}
@@ -0,0 +1,170 @@
+/*
+Transactions
+Values set between beginTransaction() and commit() must not reach the host, a text line or a getter before commit(),
+and must then go out together, once, in both delta and non-delta mode.
+*/
+
+#include <TelemetryJet.h>
+#include "TestHelpers.h"
+
+struct Host {
+  TestStream stream;
+  TelemetryJet telemetry;
+  Host() : telemetry(&stream, 1000000) {
+    telemetry.setBinaryWarningMessage(false);
+    telemetry.setReceiveQueueSize(32);
+    for (uint16_t key = 1; key <= 9; key++) {
+      telemetry.createDimension(key);
+    }
+  }
+  // Read the frames written by a device, and return the (key, value) records of each
+  std::vector<std::vector<std::pair<uint16_t, uint8_t>>> receive(TestStream& device) {
+    std::vector<std::vector<std::pair<uint16_t, uint8_t>>> records;
+    for (const std::string& frame : takeFrames(device.out)) {
+      stream.in.insert(stream.in.end(), frame.begin(), frame.end());
+      telemetry.update();
+      records.emplace_back();
+      ReceiveEvent event;
+      while (telemetry.readReceiveEvent(&event)) {
+        records.back().push_back(std::make_pair(event.key, event.value.v_uint8));
+      }
+    }
+    return records;
+  }
+};
+
+typedef std::vector<std::pair<uint16_t, uint8_t>> Records;
+
+static void testDeltaMode() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 100);
+  telemetry.setBinaryWarningMessage(false);
+  Dimension a = telemetry.createDimension(1);
+  Dimension b = telemetry.createDimension(2);
+  Host host;
+
+  // A value still waiting to be sent when the transaction begins is sent as it was
+  a.setUInt8(1);
+  telemetry.beginTransaction();
+  a.setUInt8(2);
+  b.setUInt8(2);
+  CHECK(a.getUInt8() == 1);
+  CHECK(!b.hasValue());
+  fakeMillis += 100;
+  telemetry.update();
+  auto frames = host.receive(stream);
+  CHECK(frames.size() == 1 && frames[0] == Records({{1, 1}}));
+
+  CHECK(telemetry.commit());
+  CHECK(a.getUInt8() == 2 && b.getUInt8() == 2);
+  fakeMillis += 100;
+  telemetry.update();
+  frames = host.receive(stream);
+  CHECK(frames.size() == 1 && frames[0] == Records({{1, 2}, {2, 2}}));
+
+  // Nothing is left to send
+  fakeMillis += 100;
+  telemetry.update();
+  CHECK(host.receive(stream).empty());
+}
+
+static void testFullMode() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 100);
+  telemetry.setBinaryWarningMessage(false);
+  telemetry.setDeltaMode(false);
+  Dimension a = telemetry.createDimension(1);
+  Dimension b = telemetry.createDimension(2);
+  Host host;
+
+  a.setUInt8(1);
+  b.setUInt8(1);
+  telemetry.beginTransaction();
+  a.setUInt8(2);
+  fakeMillis += 100;
+  telemetry.update();
+  b.setUInt8(2);
+  fakeMillis += 100;
+  telemetry.update();
+  auto frames = host.receive(stream);
+  CHECK(frames.size() == 2);
+  CHECK(frames[0] == Records({{1, 1}, {2, 1}}));
+  CHECK(frames[1] == Records({{1, 1}, {2, 1}}));
+
+  // Each committed value is sent once in the frame
+  CHECK(telemetry.commit());
+  fakeMillis += 100;
+  telemetry.update();
+  frames = host.receive(stream);
+  CHECK(frames.size() == 1 && frames[0] == Records({{1, 2}, {2, 2}}));
+  fakeMillis += 100;
+  telemetry.update();
+  frames = host.receive(stream);
+  CHECK(frames.size() == 1 && frames[0] == Records({{1, 2}, {2, 2}}));
+}
+
+static void testTextMode() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 100);
+  telemetry.setTextMode(true);
+  Dimension a = telemetry.createDimension(1);
+  Dimension b = telemetry.createDimension(2);
+  a.setUInt8(1);
+  b.setUInt8(1);
+  telemetry.beginTransaction();
+  a.setUInt8(2);
+  fakeMillis += 100;
+  telemetry.update();
+  CHECK(stream.out == "1 1 \n");
+  b.setUInt8(2);
+  telemetry.commit();
+  stream.out.clear();
+  fakeMillis += 100;
+  telemetry.update();
+  CHECK(stream.out == "2 2 \n");
+}
+
+// commit() only reports whether its own values fit in a frame, not those of earlier commits
+static void testCommitSize() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 100, 32);
+  telemetry.setBinaryWarningMessage(false);
+  std::vector<Dimension> dimensions;
+  for (uint16_t i = 0; i < 9; i++) {
+    dimensions.push_back(telemetry.createDimension(i + 1));
+  }
+  for (uint8_t round = 0; round < 4; round++) {
+    telemetry.beginTransaction();
+    dimensions[0].setFloat32(round);
+    dimensions[1].setFloat32(round);
+    CHECK(telemetry.commit());
+  }
+  telemetry.beginTransaction();
+  for (uint16_t i = 0; i < 8; i++) {
+    dimensions[i].setFloat32(i);
+  }
+  CHECK(!telemetry.commit());
+  telemetry.beginTransaction();
+  dimensions[8].setFloat32(8);
+  CHECK(telemetry.commit());
+
+  // The values that didn't fit are split over frames; each value is sent once, with its latest value
+  Host host;
+  fakeMillis += 100;
+  telemetry.update();
+  auto frames = host.receive(stream);
+  CHECK(frames.size() >= 2);
+  Records records;
+  for (const Records& frame : frames) {
+    records.insert(records.end(), frame.begin(), frame.end());
+  }
+  CHECK(records.size() == 9);
+}
+
+int main() {
+  testDeltaMode();
+  testFullMode();
+  testTextMode();
+  testCommitSize();
+  return TEST_RESULT();
+}
@@ -0,0 +1,190 @@
+/*
+Receiving on several transports
+Each transport keeps its own sequence and reliable delivery state: frames from two senders on two transports
+are not counted as lost or discarded because of each other, and each sender gets the ACKs for its own frames.
+Gaps, late frames and duplicates in a sender's sequence numbers are counted as lost, reordered and duplicate frames.
+Gateway routes forward frames whose first key is in their range as they are, without reading them.
+*/
+
+#include <TelemetryJet.h>
+#include "TestHelpers.h"
+
+struct Sender {
+  TestStream stream;
+  TelemetryJet telemetry;
+  Dimension value;
+  Sender(uint16_t key, bool reliable = true) : telemetry(&stream, 10), value(telemetry.createDimension(key)) {
+    telemetry.setBinaryWarningMessage(false);
+    value.setReliable(reliable);
+  }
+};
+
+static void testPerTransportState() {
+  TestStream mainStream, extraStream;
+  TelemetryJet device(&mainStream, 10);
+  device.setBinaryWarningMessage(false);
+  CHECK(device.addTransport(&extraStream));
+  Dimension fromA = device.createDimension(1);
+  Dimension fromB = device.createDimension(2);
+  Sender a(1), b(2);
+
+  for (uint8_t i = 1; i <= 40; i++) {
+    a.value.setUInt8(i);
+    b.value.setUInt8(i);
+    fakeMillis += 10;
+    a.telemetry.update();
+    b.telemetry.update();
+    if (i == 20) {
+      // One frame from A is lost on the way
+      a.stream.out.clear();
+    }
+    a.stream.sendTo(mainStream);
+    b.stream.sendTo(extraStream);
+    device.update();
+    mainStream.sendTo(a.stream);
+    extraStream.sendTo(b.stream);
+  }
+  fakeMillis += TELEMETRYJET_RELIABLE_TIMEOUT;
+  for (uint8_t i = 0; i < 3; i++) {
+    fakeMillis += 10;
+    a.telemetry.update();
+    a.stream.sendTo(mainStream);
+    device.update();
+    mainStream.sendTo(a.stream);
+  }
+
+  const ReceiveStatistics* mainStatistics = device.getReceiveStatistics(&mainStream);
+  const ReceiveStatistics* extraStatistics = device.getReceiveStatistics(&extraStream);
+  CHECK(mainStatistics != NULL && extraStatistics != NULL);
+  CHECK(device.getReceiveStatistics(&a.stream) == NULL);
+  if (mainStatistics != NULL && extraStatistics != NULL) {
+    CHECK(mainStatistics->rxFrames > 0);
+    CHECK(extraStatistics->rxFrames == 40);
+    CHECK(mainStatistics->rxLostFrames == 1);
+    CHECK(extraStatistics->rxLostFrames == 0);
+    CHECK(mainStatistics->rxReorderedFrames == 0 && extraStatistics->rxReorderedFrames == 0);
+  }
+  CHECK(device.getLinkStatistics().rxLostFrames == 1);
+
+  // Reliable values from both senders arrive; only A's lost frame had to be sent again
+  CHECK(fromA.getUInt8() == 40);
+  CHECK(fromB.getUInt8() == 40);
+  CHECK(a.telemetry.getLinkStatistics().txRetransmittedFrames > 0);
+  CHECK(b.telemetry.getLinkStatistics().txRetransmittedFrames == 0);
+
+  // The senders don't see each other's ACKs as lost frames from the device
+  CHECK(a.telemetry.getLinkStatistics().rxLostFrames == 0);
+  CHECK(b.telemetry.getLinkStatistics().rxLostFrames == 0);
+}
+
+static void testSequenceGaps() {
+  TestStream deviceStream;
+  TelemetryJet device(&deviceStream, 10);
+  device.setBinaryWarningMessage(false);
+  Dimension received = device.createDimension(1);
+  Sender sender(1, false);
+
+  // One frame per tick, numbered 1 to 10
+  std::vector<std::string> frames;
+  for (uint8_t i = 1; i <= 10; i++) {
+    sender.value.setUInt8(i);
+    fakeMillis += 10;
+    sender.telemetry.update();
+    std::vector<std::string> tick = takeFrames(sender.stream.out);
+    CHECK(tick.size() == 1);
+    frames.insert(frames.end(), tick.begin(), tick.end());
+  }
+
+  // Frame 3 is late, frame 5 arrives twice, and frames 6 and 7 never arrive
+  const uint8_t order[] = {1, 2, 4, 5, 3, 5, 8, 9, 10};
+  for (uint8_t number : order) {
+    deviceStream.in.insert(deviceStream.in.end(), frames[number - 1].begin(), frames[number - 1].end());
+    device.update();
+  }
+  const LinkStatistics& statistics = device.getLinkStatistics();
+  CHECK(statistics.rxFrames == 9);
+  CHECK(statistics.rxLostFrames == 2);
+  CHECK(statistics.rxReorderedFrames == 1);
+  CHECK(statistics.rxDuplicateFrames == 1);
+  CHECK(statistics.rxLossRate > 0.0f && statistics.rxLossRate < 1.0f);
+  CHECK(received.getUInt8() == 10);
+
+  const ReceiveStatistics* mainStatistics = device.getReceiveStatistics(&deviceStream);
+  CHECK(mainStatistics != NULL && mainStatistics->rxLostFrames == 2 && mainStatistics->rxDuplicateFrames == 1);
+
+  device.resetLinkStatistics();
+  CHECK(device.getLinkStatistics().rxLostFrames == 0 && device.getLinkStatistics().rxFrames == 0);
+}
+
+static void testRoutes() {
+  TestStream nodeLink, hostLink;
+  TelemetryJet gateway(&hostLink, 10);
+  gateway.setBinaryWarningMessage(false);
+  CHECK(gateway.addTransport(&nodeLink));
+  CHECK(gateway.addRoute(&nodeLink, &hostLink, 100, 199));
+  Dimension ownValue = gateway.createDimension(50);
+  Dimension routedValue = gateway.createDimension(150);
+
+  Sender node(150, false);
+  Dimension nodeOwnValue = node.telemetry.createDimension(50);
+
+  // A frame starting with a routed key is forwarded byte for byte, and not read by the gateway
+  node.value.setUInt8(1);
+  fakeMillis += 10;
+  node.telemetry.update();
+  std::string frame = node.stream.out;
+  node.stream.sendTo(nodeLink);
+  gateway.update();
+  CHECK(hostLink.out == frame);
+  CHECK(!routedValue.hasValue());
+  CHECK(gateway.getLinkStatistics().rxForwardedFrames == 1);
+  CHECK(gateway.getLinkStatistics().rxFrames == 0);
+  hostLink.out.clear();
+
+  // Other keys are read as usual
+  nodeOwnValue.setUInt8(2);
+  fakeMillis += 10;
+  node.telemetry.update();
+  node.stream.sendTo(nodeLink);
+  gateway.update();
+  CHECK(ownValue.getUInt8() == 2);
+  CHECK(takeFrames(hostLink.out).empty());
+
+  // Frames with a bad checksum are dropped, not forwarded
+  node.value.setUInt8(3);
+  fakeMillis += 10;
+  node.telemetry.update();
+  node.stream.out[0] ^= 0x01;
+  node.stream.sendTo(nodeLink);
+  gateway.update();
+  CHECK(hostLink.out.empty());
+  CHECK(gateway.getLinkStatistics().rxDroppedChecksum == 1);
+
+  // Reliable frames start with a control record, so they only follow full range routes
+  node.value.setReliable(true);
+  node.value.setUInt8(4);
+  fakeMillis += 10;
+  node.telemetry.update();
+  node.stream.sendTo(nodeLink);
+  gateway.update();
+  CHECK(routedValue.getUInt8() == 4);
+  hostLink.out.clear();
+
+  gateway.clearRoutes();
+  CHECK(gateway.addRoute(&nodeLink, &hostLink));
+  node.value.setUInt8(5);
+  fakeMillis += TELEMETRYJET_RELIABLE_TIMEOUT;
+  node.telemetry.update();
+  frame = node.stream.out;
+  node.stream.sendTo(nodeLink);
+  gateway.update();
+  CHECK(!frame.empty() && hostLink.out == frame);
+  CHECK(routedValue.getUInt8() == 4);
+}
+
+int main() {
+  testPerTransportState();
+  testSequenceGaps();
+  testRoutes();
+  return TEST_RESULT();
+}
@@ -0,0 +1,204 @@
+/*
+Waveforms
+A full block is split into as many frames as the frame size needs, and the chunks put back together give the
+block's samples in order. The link budget holds blocks back, a block that fills up while the previous one is
+still being sent is dropped and counted, and a waveform that can't be allocated is not valid.
+*/
+
+#include <TelemetryJet.h>
+#include <MessagePack.h>
+#include "TestHelpers.h"
+
+extern "C" void* __libc_malloc(size_t size);
+
+// Allocations fail while set, to test the out of memory paths
+static bool isMallocFailing = false;
+
+extern "C" void* malloc(size_t size) {
+  return isMallocFailing ? NULL : __libc_malloc(size);
+}
+
+struct Chunk {
+  uint16_t sequence;
+  uint32_t sampleRate;
+  uint16_t offset;
+  std::vector<int16_t> samples;
+};
+
+// Decode the waveform block record in each frame
+static std::vector<Chunk> takeChunks(std::string& out, uint16_t key) {
+  std::vector<Chunk> chunks;
+  for (const std::string& frame : takeFrames(out)) {
+    std::string payload = framePayload(frame);
+    mpack_reader_t reader;
+    mpack_reader_init_data(&reader, payload.data(), payload.size());
+    CHECK(mpack_expect_u16(&reader) == key);
+    CHECK(mpack_expect_u8(&reader) == TELEMETRYJET_BLOCK_TYPE);
+    CHECK(mpack_expect_array(&reader) == 5);
+    Chunk chunk;
+    chunk.sequence = mpack_expect_u16(&reader);
+    chunk.sampleRate = mpack_expect_u32(&reader);
+    mpack_expect_u32(&reader);
+    chunk.offset = mpack_expect_u16(&reader);
+    uint32_t length = mpack_expect_bin(&reader);
+    for (uint32_t i = 0; i < length / 2; i++) {
+      uint8_t bytes[2];
+      mpack_read_bytes(&reader, (char*)bytes, 2);
+      chunk.samples.push_back((int16_t)(bytes[0] | (bytes[1] << 8)));
+    }
+    mpack_done_bin(&reader);
+    mpack_done_array(&reader);
+    CHECK(mpack_reader_remaining(&reader, NULL) == 0);
+    CHECK(mpack_reader_destroy(&reader) == mpack_ok);
+    chunks.push_back(chunk);
+  }
+  return chunks;
+}
+
+static void testBlockSplitting() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 10);
+  telemetry.setBinaryWarningMessage(false);
+  CHECK(telemetry.setMaxFrameSize(64));
+  Waveform current = telemetry.createWaveform(50, 10000, 100);
+  CHECK(current.isValid());
+  CHECK(current.getBlockSize() == 100);
+  CHECK(current.getSampleRate() == 10000);
+
+  for (int16_t i = 0; i < 100; i++) {
+    CHECK(current.push(i * 300 - 15000));
+  }
+  fakeMillis += 10;
+  telemetry.update();
+  std::vector<Chunk> chunks = takeChunks(stream.out, 50);
+
+  // More than one frame, and every chunk starts where the last one ended
+  CHECK(chunks.size() > 1);
+  uint16_t offset = 0;
+  for (const Chunk& chunk : chunks) {
+    CHECK(chunk.sequence == 0);
+    CHECK(chunk.sampleRate == 10000);
+    CHECK(chunk.offset == offset);
+    for (size_t i = 0; i < chunk.samples.size(); i++) {
+      CHECK(chunk.samples[i] == (int16_t)((offset + i) * 300 - 15000));
+    }
+    offset += chunk.samples.size();
+  }
+  CHECK(offset == 100);
+  CHECK(telemetry.getLinkStatistics().txWaveformBlocks == 1);
+
+  // The next block carries the next sequence number
+  for (int16_t i = 0; i < 100; i++) {
+    current.push(i);
+  }
+  fakeMillis += 10;
+  telemetry.update();
+  chunks = takeChunks(stream.out, 50);
+  CHECK(!chunks.empty() && chunks[0].sequence == 1);
+}
+
+static void testBudget() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 10);
+  telemetry.setBinaryWarningMessage(false);
+  CHECK(telemetry.setMaxFrameSize(64));
+  telemetry.setWaveformBudget(1000);
+  Waveform current = telemetry.createWaveform(50, 10000, 200);
+  for (int16_t i = 0; i < 200; i++) {
+    current.push(i);
+  }
+
+  // About 1000 bytes per second, after a burst of at most one frame
+  uint32_t sentBytes = 0;
+  for (int tick = 0; tick < 20; tick++) {
+    fakeMillis += 10;
+    telemetry.update();
+    sentBytes += stream.out.size();
+    stream.out.clear();
+  }
+  CHECK(sentBytes > 64 && sentBytes <= 64 + 200 + 64);
+  CHECK(telemetry.getLinkStatistics().txWaveformBlocks == 0);
+  CHECK(telemetry.getLinkStatistics().txWaveformBytes == sentBytes);
+
+  // The block still goes out in the end
+  for (int tick = 0; tick < 100; tick++) {
+    fakeMillis += 10;
+    telemetry.update();
+  }
+  CHECK(telemetry.getLinkStatistics().txWaveformBlocks == 1);
+}
+
+static void testDroppedBlocks() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 10);
+  telemetry.setBinaryWarningMessage(false);
+  Waveform current = telemetry.createWaveform(50, 10000, 10);
+
+  // The first block waits to be sent, so the second and third ones have nowhere to go
+  for (int i = 0; i < 10; i++) {
+    CHECK(current.push(1));
+  }
+  for (int i = 0; i < 9; i++) {
+    CHECK(current.push(2));
+  }
+  CHECK(!current.push(2));
+  for (int i = 0; i < 9; i++) {
+    current.push(3);
+  }
+  CHECK(!current.push(3));
+
+  fakeMillis += 10;
+  telemetry.update();
+  CHECK(telemetry.getLinkStatistics().txWaveformDroppedBlocks == 2);
+  CHECK(telemetry.getLinkStatistics().txWaveformBlocks == 1);
+  std::vector<Chunk> chunks = takeChunks(stream.out, 50);
+  CHECK(chunks.size() == 1 && chunks[0].sequence == 0 && chunks[0].samples[0] == 1);
+
+  // With room again, the next block is sent, and its sequence number shows the gap
+  for (int i = 0; i < 10; i++) {
+    CHECK(current.push(4));
+  }
+  fakeMillis += 10;
+  telemetry.update();
+  chunks = takeChunks(stream.out, 50);
+  CHECK(chunks.size() == 1 && chunks[0].sequence == 3 && chunks[0].samples[0] == 4);
+  CHECK(telemetry.getLinkStatistics().txWaveformDroppedBlocks == 2);
+}
+
+static void testInvalidWaveforms() {
+  TestStream stream;
+  TelemetryJet telemetry(&stream, 10);
+  telemetry.setBinaryWarningMessage(false);
+  Waveform first = telemetry.createWaveform(50, 1000, 4);
+
+  // Out of memory: the waveforms created before are kept
+  isMallocFailing = true;
+  Waveform failed = telemetry.createWaveform(51, 1000, 4);
+  isMallocFailing = false;
+  CHECK(!failed.isValid());
+  CHECK(!failed.push(1));
+  CHECK(failed.getBlockSize() == 0);
+  for (int i = 0; i < 4; i++) {
+    first.push(7);
+  }
+  fakeMillis += 10;
+  telemetry.update();
+  std::vector<Chunk> chunks = takeChunks(stream.out, 50);
+  CHECK(chunks.size() == 1 && chunks[0].samples.size() == 4);
+
+  // Waveform IDs are 8 bits wide
+  for (int i = 1; i < 255; i++) {
+    CHECK(telemetry.createWaveform(100 + i, 1000, 1).isValid());
+  }
+  Waveform tooMany = telemetry.createWaveform(400, 1000, 1);
+  CHECK(!tooMany.isValid());
+  CHECK(first.getSampleRate() == 1000);
+}
+
+int main() {
+  testBlockSplitting();
+  testBudget();
+  testDroppedBlocks();
+  testInvalidWaveforms();
+  return TEST_RESULT();
+}